@@ -1,5 +1,9 @@
 #include <vector>
 #include <variant>
+#include <atomic>
+#include <optional>
+#include <thread>
+#include <utility>
 #include <fstream>
 #include <iostream>
 #include <sstream>
@@ -8,6 +12,7 @@
 #include <gtest/gtest.h>
 
 #include "aoc.h"
+#include "utils.h"
 
 namespace aoc_tests {
 using namespace std;
@@ -33,10 +38,10 @@ vector<tuple<string, Result, Result>> testFiles{
     {"./data/input18Test", 62, 952408144115},
     {"./data/input19Test", 19114, 167409079868000},
     {"./data/input20Test", 32000000, 0},
-    {"./data/input21Test", 42, 528192461129799},
+    {"./data/input21Test", 42, 470149643712804},
     {"./data/input22Test", 5, 7},
     {"./data/input23Test", 94, 154},
-    {"./data/input24Test", 0, 886858737029295},
+    {"./data/input24Test", 0, 47},
     {"./data/input25Test", 54, 54},
 };
 
@@ -104,6 +109,110 @@ string readFile(const string &filePath) {
     }
 
 
+// Workflows with only a fallback, to an accepting/rejecting state or to another workflow
+TEST(AoCTest, Day19RulelessWorkflows) {
+    string input = "in{fwd}\nfwd{x>10:ok,rej}\nok{A}\nrej{R}\n\n{x=5,m=1,a=1,s=1}\n{x=20,m=2,a=3,s=4}";
+    EXPECT_EQ(aoc19::solvePartOne(input), Result{29});
+    EXPECT_EQ(aoc19::solvePartTwo(input), Result{(int64_t)3990 * 4000 * 4000 * 4000});
+
+    string acceptAll = "in{A}\n\n{x=1,m=2,a=3,s=4}";
+    EXPECT_EQ(aoc19::solvePartOne(acceptAll), Result{10});
+    EXPECT_EQ(aoc19::solvePartTwo(acceptAll), Result{(int64_t)4000 * 4000 * 4000 * 4000});
+}
+
+TEST(UtilsTest, CrtCoprimeModuli) {
+    EXPECT_EQ(aoc::crt(2, 3, 3, 5), make_optional(make_pair<int64_t, int64_t>(8, 15)));
+    EXPECT_EQ(aoc::crt(1, 1000000007, 2, 998244353),
+        make_optional(make_pair<int64_t, int64_t>(993328913953302350, 998244359987710471)));
+}
+
+TEST(UtilsTest, CrtNonCoprimeModuli) {
+    // t = 2 (mod 4) and t = 4 (mod 6)
+    EXPECT_EQ(aoc::crt(2, 4, 4, 6), make_optional(make_pair<int64_t, int64_t>(10, 12)));
+    // t = 1 (mod 4) is odd, t = 2 (mod 6) is even
+    EXPECT_EQ(aoc::crt(1, 4, 2, 6), nullopt);
+    EXPECT_EQ(aoc::crt(3, 6, 3, 6), make_optional(make_pair<int64_t, int64_t>(3, 6)));
+}
+
+TEST(UtilsTest, FirstCommonEvent) {
+    // Events at the end of each period
+    EXPECT_EQ(aoc::firstCommonEvent({{3, 3, {}, {0}}, {4, 4, {}, {0}}}), 12);
+    // Common event before all processes are cycling
+    EXPECT_EQ(aoc::firstCommonEvent({{5, 7, {2}, {1}}, {0, 2, {}, {0}}}), 2);
+    // Combined residues, after the slowest process starts cycling
+    EXPECT_EQ(aoc::firstCommonEvent({{0, 4, {}, {1, 2}}, {10, 6, {}, {4}}}), 10);
+    // Residues with no common solution
+    EXPECT_EQ(aoc::firstCommonEvent({{0, 4, {}, {1}}, {0, 6, {}, {2}}}), nullopt);
+}
+
+TEST(UtilsTest, BitGridPartialWords) {
+    auto grid = aoc::BitGrid(70, 3);
+    EXPECT_EQ(grid.wordsPerLine, 2);
+    for (int x : {0, 63, 64, 69}) grid.set(x, 1);
+    EXPECT_TRUE(grid.test(64, 1));
+    EXPECT_FALSE(grid.test(65, 1));
+    EXPECT_EQ(grid.count(1, 0, 70), 4);
+    EXPECT_EQ(grid.count(1, 60, 65), 2);
+    EXPECT_EQ(grid.count(0, 0, 70), 0);
+
+    grid.assign(2, 1, 69, true);
+    EXPECT_EQ(grid.count(2, 0, 70), 68);
+    EXPECT_FALSE(grid.test(0, 2));
+    EXPECT_FALSE(grid.test(69, 2));
+    grid.assign(2, 60, 66, false);
+    EXPECT_EQ(grid.count(2, 0, 70), 62);
+    grid.set(63, 1, false);
+    EXPECT_EQ(grid.count(1, 0, 70), 3);
+}
+
+TEST(UtilsTest, BitGridTranspose) {
+    auto grid = aoc::BitGrid(130, 70);
+    for (int y = 0; y < grid.height; y++) {
+        for (int x = 0; x < grid.width; x++) grid.set(x, y, (x * 7 + y * 3) % 5 == 0);
+    }
+    auto transposed = aoc::BitGrid{}, back = aoc::BitGrid{};
+    grid.transposeInto(transposed);
+    EXPECT_EQ(transposed.width, 70);
+    EXPECT_EQ(transposed.height, 130);
+    for (int y = 0; y < grid.height; y++) {
+        for (int x = 0; x < grid.width; x++) ASSERT_EQ(transposed.test(y, x), grid.test(x, y));
+    }
+    transposed.transposeInto(back);
+    EXPECT_EQ(back, grid);
+}
+
+TEST(UtilsTest, BucketSearch) {
+    // 0 -> 1 (5), 0 -> 2 (1), 2 -> 1 (1), 1 -> 3 (1), and 4 is unreachable
+    auto edges = vector<vector<pair<int, int>>>{{{1, 5}, {2, 1}}, {{3, 1}}, {{1, 1}}, {}, {}};
+    auto successors = [&edges](int state, vector<pair<int, int>> &next) {
+        next.insert(next.end(), edges[state].begin(), edges[state].end());
+    };
+    EXPECT_EQ(aoc::bucketSearch(5, {0}, 5, successors, [](int s) { return s == 3; }), 3);
+    EXPECT_EQ(aoc::bucketSearch(5, {0}, 5, successors, [](int s) { return s == 4; }), nullopt);
+    EXPECT_EQ(aoc::bucketSearch(5, {3, 0}, 5, successors, [](int s) { return s == 3; }), 0);
+}
+
+TEST(UtilsTest, ParallelReduce) {
+    auto sum = [](int64_t a, int64_t b) { return a + b; };
+    auto value = [](size_t i) { return (int64_t)i + 1; };
+    // No items, and fewer items than threads
+    EXPECT_EQ(aoc::parallelReduce(0, (int64_t)0, value, sum), 0);
+    EXPECT_EQ(aoc::parallelReduce(1, (int64_t)0, value, sum), 1);
+    EXPECT_EQ(aoc::parallelReduce(3, (int64_t)0, value, sum), 6);
+    EXPECT_EQ(aoc::parallelReduce(10000, (int64_t)0, value, sum), (int64_t)10000 * 10001 / 2);
+    EXPECT_EQ(aoc::parallelReduce(0, optional<int64_t>{}, [](size_t i) { return optional<int64_t>{i}; },
+        [](optional<int64_t> a, optional<int64_t> b) { return (a && b) ? max(a, b) : (a ? a : b); }), nullopt);
+
+    // One state per thread, with no more threads than items
+    for (size_t n : {0, 2, 1000}) {
+        auto states = atomic<int>{0};
+        auto total = aoc::parallelReduce(n, (int64_t)0, [&states]() { return ++states; },
+            [](int, size_t i) { return (int64_t)i; }, sum);
+        EXPECT_EQ(total, (int64_t)n * ((int64_t)n - 1) / 2);
+        EXPECT_LE(states.load(), max<int>(1, min<size_t>(thread::hardware_concurrency(), n)));
+    }
+}
+
 REPEAT_FOR_DAY(AOC_TEST_TEST_FILES)
 REPEAT_FOR_DAY(AOC_TEST_DATA_FILES)
 
@@ -1,12 +1,15 @@
 #include <algorithm>
+#include <array>
+#include <bit>
 #include <iostream>
-#include <unordered_map>
 #include <numeric>
+#include <optional>
 #include <ranges>
 #include <string>
 #include <string_view>
 #include <vector>
 #include <cmath>
+#include <cstdint>
 #include <utility>
 
 #include "aoc.h"
@@ -17,140 +20,77 @@ namespace aoc10 {
 using namespace std;
 using namespace aoc;
 
-using Pos = vec2<int>;
-using Dir = vec2<int>;
-
-// Directions and Invalid marker
-constexpr auto 
-  NORTH = Dir(0, -1),
-  SOUTH = Dir(0, 1),
-  EAST = Dir(-1, 0),
-  WEST = Dir(1, 0),
-  INVALID = Dir(-1, -1);
-
-// Inverts a direction, useful for entry/exit switches on cells
-inline Dir rotate180(const Dir &pos) { return Dir(pos.x * -1, pos.y * -1); }
-
-// Exit points for each cell type
-inline unordered_map<char, pair<Dir, Dir>> getExits() {
-  return {
-    {'|', { NORTH, SOUTH} },
-    {'-', { EAST, WEST} },
-    {'J', { EAST, NORTH} },
-    {'L', { WEST, NORTH} },
-    {'F', { WEST, SOUTH} },
-    {'7', { EAST, SOUTH} },
+// Directions, ordered so that the opposite of d is d ^ 1, and their offsets
+enum Dir { NORTH, SOUTH, EAST, WEST };
+constexpr int dx[] = { 0, 0, 1, -1 }, dy[] = { -1, 1, 0, 0 };
+
+constexpr uint8_t bit(int d) { return 1 << d; }
+
+// Exit points for each cell type, as a mask of direction bits indexed by the cell char
+constexpr array<uint8_t, 256> exits = []() {
+  auto ret = array<uint8_t, 256>{};
+  ret['|'] = bit(NORTH) | bit(SOUTH);
+  ret['-'] = bit(EAST) | bit(WEST);
+  ret['L'] = bit(NORTH) | bit(EAST);
+  ret['J'] = bit(NORTH) | bit(WEST);
+  ret['7'] = bit(SOUTH) | bit(WEST);
+  ret['F'] = bit(SOUTH) | bit(EAST);
+  return ret;
+}();
+
+// Length of the loop and twice its signed area
+struct Loop {
+  int64_t length, area2;
+};
+
+/**
+ * Walks the loop through the start position, directly on the input, accumulating
+ * its length and area (by the Shoelace formula) on the way. The walk starts on the
+ * first neighbor of the start that connects to it, and tries the next ones only if
+ * that doesn't return to the start
+ *
+ * @param input Maze, as lines of the same width
+ * @return Length and area of the loop, if there's one
+*/
+optional<Loop> walkLoop(const string &input) {
+  int64_t w = input.find('\n'), stride = w + 1, h = (input.size() + 1) / stride;
+  int64_t start = input.find('S'), startX = start % stride, startY = start / stride;
+  auto cell = [&](int64_t x, int64_t y) -> char {
+    return (inBounds(x, (int64_t)0, w) && inBounds(y, (int64_t)0, h)) ? input[y * stride + x] : '.';
   };
-}
-
-
-// Returns the Start 'S' position on the maze
-Pos findStartPos(const auto &maze) {
-  for (int y = 0; y < maze.size(); y++) {
-    for (int x = 0; x < maze[y].size(); x++) {
-      if (maze[y][x] == 'S') {
-        return Pos{x, y};
-      }
-    }
-  }
-  return INVALID;
-}
-
-// Finds the biggest loop on the maze
-vector<Pos> findMaxLoop(const auto &maze) {
-  const auto dirs = vector<Dir>{ EAST, WEST, NORTH, SOUTH };
-  const auto exits = getExits();
-
-  auto startPos = findStartPos(maze);
-  auto maxLoop = vector<Pos>{};
-  // Try each direction from the start position
-  for (auto d : dirs) {
-    auto entryDir = rotate180(d);
-    auto currPos = startPos + d;
-    if (!insideBoard(maze, currPos)) continue;
-
-    // Follow maze until returning to start position
-    auto currLoop = vector<Pos>{currPos};
-    while (currPos != startPos) {
-      // Handle dead ends '.'
-      if (!exits.contains(maze[currPos.y][currPos.x])) break;
 
-      const auto &dirs = exits.at(maze[currPos.y][currPos.x]);
-      // Exit dir is the opposite of entry dir
-      auto exitDir = 
-        (entryDir == dirs.first) ? dirs.second : 
-          (entryDir == dirs.second) ? dirs.first : INVALID;
-      // Break if no suitable exit found, this cell isn't a continuation of the previous one
-      if (exitDir == INVALID) break;
-
-      // Set up next pos and dir, save curr pos
-      auto nextPos = currPos + exitDir;
-      if (!insideBoard(maze, nextPos)) break;
-      currPos = nextPos;
-      entryDir = rotate180(exitDir);
-      currLoop.push_back(currPos);
-    }
-    if (currPos == startPos && currLoop.size() > maxLoop.size()) {
-      // New max loop
-      maxLoop = currLoop;
+  for (int startDir = NORTH; startDir <= WEST; startDir++) {
+    int64_t x = startX, y = startY;
+    auto ret = Loop{0, 0};
+    for (int d = startDir; ; ) {
+      int64_t nx = x + dx[d], ny = y + dy[d];
+      ret.area2 += x * ny - nx * y;
+      ret.length++;
+      x = nx;
+      y = ny;
+      if (x == startX && y == startY) return ret;
+
+      // Exit is the cell's other direction, if it connects with where we came from
+      uint8_t mask = exits[(uint8_t)cell(x, y)], entry = bit(d ^ 1);
+      if (!(mask & entry)) break;
+      d = countr_zero((uint8_t)(mask & ~entry));
     }
   }
-  return maxLoop;
+  return nullopt;
 }
 
 Result solvePartOne(const string &input) {
-  auto maze = toVector(input | splitString('\n'));
-  auto maxLoop = findMaxLoop(maze);
-  return (int64_t)ceil(maxLoop.size() / 2);
+  auto loop = walkLoop(input);
+  if (!loop) return monostate();
+  return loop->length / 2;
 }
 
-
 Result solvePartTwo(const string &input) {
-  auto maze = toVector(input | splitString('\n'));
-  auto maxLoop = findMaxLoop(maze);
-  if (maxLoop.size() == 0) return monostate();
-
-  // Create a maze copy with just the main loop
-  int h = maze.size(), w = maze[0].size();
-  auto scratch = vector(h, string(w, '.'));
-  for (auto p : maxLoop) {
-    scratch[p.y][p.x] = maze[p.y][p.x];
-  }
-
-  // Deduce the start position character
-  const auto exits = getExits();
-  auto startPos = maxLoop.back();
-  auto startExitDirs = make_pair(maxLoop[maxLoop.size() - 2] - startPos, maxLoop.front() - startPos);
-  char startChar;
-  for (auto e : exits) {
-    if ((e.second.first == startExitDirs.first && e.second.second == startExitDirs.second) ||
-        (e.second.second == startExitDirs.first && e.second.first == startExitDirs.second)) {
-      startChar = e.first;
-      break;
-    }
-  }
-  scratch[startPos.y][startPos.x] = startChar;
-
-  // Count inside cells. Loop on lines and when a wall is found invert the 
-  // inside indicator. Only invert on | and one of the corner pairs [F, 7] or
-  // [L, J] otherwise we could be double inverting the indicator 
-  bool in = false;
-  int64_t inCount = 0;
-  for (auto y = 0; y < h; y++) {
-    for (auto x = 0; x < w; x++) {
-      switch (scratch[y][x]) {
-      case '|': case 'F': case '7':
-        in = !in;
-        break;
-      case '.':
-        inCount += in;
-        break;
-      }
-      // scratch[y][x] = (in && scratch[y][x] == '.') ? 'I' : scratch[y][x];
-    }
-  }
-
-  return inCount;
+  // By Pick's theorem, A = i + b/2 - 1, where i are the inside cells
+  // and b the cells on the boundary, which is the loop
+  auto loop = walkLoop(input);
+  if (!loop) return monostate();
+  return abs(loop->area2) / 2 - loop->length / 2 + 1;
 }
 
 } // namespace aoc10
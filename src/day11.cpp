@@ -6,6 +6,7 @@
 #include <string>
 #include <string_view>
 #include <vector>
+#include <cstdint>
 
 #include "aoc.h"
 #include "utils.h"
@@ -15,54 +16,62 @@ namespace aoc11 {
 using namespace std;
 using namespace aoc;
 
-using Pos = vec2<int64_t>;
+/**
+ * Sum of the distances between all pairs of galaxies, split into the distance that
+ * doesn't depend on the expansion and the number of times empty lines are crossed,
+ * so that the sum for any expansion factor is base + factor * emptyCrossings
+*/
+struct DistanceSum {
+  int64_t base, emptyCrossings;
 
-constexpr int64_t EXP_FACTOR = 100;
+  int64_t expanded(int64_t factor) const { return base + factor * emptyCrossings; }
+};
 
-vector<int64_t> findEmptyRows(const auto &board) {
-  auto empty = vector<int64_t>{};
-  for (auto i = 0; i < board.size(); i++) {
-    if (ranges::all_of(board[i], [](char c) { return c == '.';})) {
-      empty.push_back(i);
-    }
+/**
+ * Sums the distances between all pairs of galaxies along one axis, given the number
+ * of galaxies on each line. Between lines c and c+1, the distances of all pairs with
+ * one galaxy on each side are increased by 1 (and the expansion if c is empty), so
+ * each gap contributes (galaxies up to c) * (galaxies after c)
+ *
+ * @param counts Number of galaxies on each line along the axis
+ * @return Distance sum along the axis
+*/
+DistanceSum axisDistances(const vector<int64_t> &counts) {
+  int64_t total = accumulate(counts.begin(), counts.end(), (int64_t)0), before = 0;
+  auto ret = DistanceSum{0, 0};
+  for (auto c : counts) {
+    before += c;
+    auto crossings = before * (total - before);
+    ret.base += crossings;
+    if (c == 0) ret.emptyCrossings += crossings;
   }
-  return empty;
+  return ret;
 }
 
-Result solve(const string &input, int64_t expandFactor = 1) {
-  auto board = toVector(input | splitString('\n'));
-  auto h = board.size(), w = board[0].size();
-  // Find empty rows and columns
-  auto emptyRows = findEmptyRows(board), 
-       emptyCols = findEmptyRows(transposeBoard(board));
-
-  // Find positions
-  auto positions = vector<Pos>{};
-  for (auto y = 0; y < h; y++) {
-    for (auto x = 0; x < w; x++) {
-      if (board[y][x] == '#') positions.push_back(Pos(x, y));
+/**
+ * Counts the galaxies on each row and column in a single pass over the input, and
+ * sums the distances on both axis, as Manhattan distance is separable
+ *
+ * @param input Input
+ * @return Sum of the distances between all pairs of galaxies
+*/
+DistanceSum galaxyDistances(const string &input) {
+  size_t w = input.find('\n'), stride = w + 1, h = (input.size() + 1) / stride;
+  auto rows = vector<int64_t>(h), cols = vector<int64_t>(w);
+  for (size_t y = 0; y < h; y++) {
+    for (size_t x = 0; x < w; x++) {
+      bool galaxy = input[y * stride + x] == '#';
+      rows[y] += galaxy;
+      cols[x] += galaxy;
     }
   }
 
-  // Expand positions with the empty rows and columns
-  // Note: making this a vector instead of a range is 10x faster later on
-  auto expandedPositions = toVector(positions
-    | views::transform([&emptyRows, &emptyCols, expandFactor](auto p) {
-      auto expanded = p;
-      for (auto n: emptyRows) if (p.y > n) expanded.y += expandFactor;
-      for (auto n: emptyCols) if (p.x > n) expanded.x += expandFactor;
-      return expanded;
-    }));
-
-  // Calculate Manhattan Distance between pairs of positions
-  auto res = int64_t{0};
-  for (auto i = 0; i < expandedPositions.size() - 1; i++) {
-    for (auto j = i+1; j < expandedPositions.size(); j++) {
-      res += expandedPositions[i].manhattanDistanceTo(expandedPositions[j]);
-    }
-  }
+  auto dy = axisDistances(rows), dx = axisDistances(cols);
+  return DistanceSum{dx.base + dy.base, dx.emptyCrossings + dy.emptyCrossings};
+}
 
-  return res;
+Result solve(const string &input, int64_t expandFactor = 1) {
+  return galaxyDistances(input).expanded(expandFactor);
 }
 
 Result solvePartOne(const string &input) {
@@ -2,12 +2,14 @@
 #include <iostream>
 #include <map>
 #include <numeric>
+#include <optional>
 #include <ranges>
+#include <span>
 #include <string>
 #include <string_view>
 #include <vector>
 #include <utility>
-#include <unordered_map>
+#include <cstdint>
 
 #include "aoc.h"
 #include "utils.h"
@@ -17,81 +19,105 @@ namespace aoc12 {
 using namespace std;
 using namespace aoc;
 
-static unordered_map<int64_t, int64_t>cache;
+using int128 = __int128;
 
-// https://en.wikipedia.org/wiki/Pairing_function#Cantor_pairing_function
-inline int64_t cantorPairingFunction(int64_t k1, int64_t k2) {
-  return (k1 + k2) * (k1 + k2 + 1) / 2 + k2;
-}
+/**
+ * Counts the arrangements of a record with an iterative DP, where ways[g][p] is the
+ * number of ways to place the groups from g onwards on the record from position p
+ * onwards. Only the rows for groups g and g+1 are kept, in flat vectors indexed by
+ * position. The buffers are kept between calls, so a counter can be reused for many
+ * lines without allocating. Counts grow exponentially with the unfold factor, so
+ * they're checked for overflow on the count type T
+*/
+template<typename T>
+class ArrangementCounter {
+public:
+  optional<T> count(string_view baseRecord, span<const int> baseGroups, int unfold) {
+    record.clear();
+    groups.clear();
+    for (int i = 0; i < unfold; i++) {
+      if (i > 0) record.push_back('?');
+      record.append(baseRecord);
+      groups.insert(groups.end(), baseGroups.begin(), baseGroups.end());
+    }
+    int n = record.size();
+
+    // Position of the next '.' from each position, to check if groups fit there
+    nextDot.resize(n + 1);
+    nextDot[n] = n;
+    for (int p = n - 1; p >= 0; p--) nextDot[p] = (record[p] == '.') ? p : nextDot[p + 1];
 
-// Calculates the possible combinations starting on recPos and groupPos
-int64_t calcCombinations(string_view record, const vector<int> &groups, int recPos = 0, int groupPos = 0) {
-  auto thisGroup = groups[groupPos];
-  // Estimate the space needed at the end for the remaining groups
-  auto spacer = accumulate(groups.begin() + groupPos, groups.end(), 0) + groups.size() - 1 - groupPos;
-  auto combinations = int64_t{ 0 };
-  // Loop on each character, checking if the current group can be placed there
-  for (int pos = recPos; pos <= record.size() - spacer; pos++) {
-    bool fits = record.find('.', pos) >= pos + thisGroup && 
-        (pos + thisGroup == record.size() || record[pos+thisGroup] != '#');
+    // With no groups left, the remaining record can't have any '#'
+    int lastHash = (int)record.rfind('#');
+    next.resize(n + 2);
+    for (int p = 0; p <= n + 1; p++) next[p] = (p > lastHash);
 
-    if (fits) {
-      // Current group fits on current pos. If it's the last one count one more combination, 
-      // otherwise recurse with remaining groups from the current pos
-      if (groupPos == groups.size() - 1) {
-        // Last group, check if we should have matched further ahead - any # remaining?
-        bool poundsRemaining = record.find('#', pos + thisGroup) != string::npos;
-        if (!poundsRemaining) combinations++;
-      } else {
-        // Recurse, but check cache first
-        auto nextRecPos = pos + thisGroup + 1, nextGroupPos = groupPos + 1;
-        auto cacheKey = cantorPairingFunction(nextRecPos, nextGroupPos);
-        if (!cache.contains(cacheKey)) {
-          cache[cacheKey] = calcCombinations(record, groups, nextRecPos, nextGroupPos);
+    bool overflow = false;
+    for (int g = groups.size() - 1; g >= 0; g--) {
+      int len = groups[g];
+      curr.assign(n + 2, 0);
+      for (int p = n - 1; p >= 0; p--) {
+        // Either skip this position or place the group here, followed by a separator
+        T ways = (record[p] != '#') ? curr[p + 1] : 0;
+        if (p + len <= n && nextDot[p] >= p + len && (p + len == n || record[p + len] != '#')) {
+          overflow |= __builtin_add_overflow(ways, next[p + len + 1], &ways);
         }
-        combinations += cache[cacheKey];
+        curr[p] = ways;
       }
+      swap(curr, next);
     }
-    // Must fit at most in this pos
-    if (record[pos] == '#') break;
+    if (overflow) return nullopt;
+    return next[0];
   }
 
-  return combinations;
-}
+private:
+  string record;
+  vector<int> groups, nextDot;
+  vector<T> curr, next;
+};
 
 auto parseInput(const string &input) {
-  return input
+  return toVector(input
     | splitString('\n')
     | views::transform([](string_view str) {
       size_t sep = str.find(' ');
       return make_pair(str.substr(0, sep), toVector(str.substr(sep + 1) | splitNumbers(',')));
-    });
+    }));
 }
 
-Result solvePartOne(const string &input) {
-  auto rg = parseInput(input)
-    | views::transform([](auto pair) {
-      cache.clear();    // Clear cache on each line
-      return calcCombinations(pair.first, pair.second);
-    });
+/**
+ * Sums the arrangements of all lines, unfolded by a factor. Lines are split between
+ * threads, each one with its own counters, and the partial sums are added at the end.
+ * Lines are counted in 64 bits, and again in 128 bits if they overflow
+ *
+ * @param input Input
+ * @param unfold Number of copies of each record/groups
+ * @return Total number of arrangements, or nothing if it doesn't fit in 64 bits
+*/
+Result solve(const string &input, int unfold) {
+  auto lines = parseInput(input);
 
-  return accumulate(rg.begin(), rg.end(), static_cast<int64_t>(0));
+  // Sum of the arrangements, or nullopt once a line or the sum overflows 128 bits
+  auto checkedAdd = [](optional<int128> a, optional<int128> b) -> optional<int128> {
+    int128 ret;
+    if (!a || !b || __builtin_add_overflow(*a, *b, &ret)) return nullopt;
+    return ret;
+  };
+  auto makeCounters = []() { return pair{ArrangementCounter<int64_t>{}, ArrangementCounter<int128>{}}; };
+  auto total = parallelReduce(lines.size(), optional<int128>{0}, makeCounters, [&lines, unfold](auto &counters, size_t i) {
+    auto &[narrow, wide] = counters;
+    optional<int128> ways = narrow.count(lines[i].first, lines[i].second, unfold);
+    return ways ? ways : wide.count(lines[i].first, lines[i].second, unfold);
+  }, checkedAdd);
+  if (!total || *total > INT64_MAX) return monostate();
+  return (int64_t)*total;
 }
 
-Result solvePartTwo(const string &input) {
-  auto rg = parseInput(input)
-    | views::transform([](auto pair) {
-      cache.clear();    // Clear cache on each line
-      // Expand input by 5
-      auto records = string{ pair.first };
-      auto groups = vector<int>{ pair.second };
-      for (int i = 0; i < 4; i++) {
-        records.append("?").append(pair.first);
-        groups.insert(groups.end(), pair.second.begin(), pair.second.end());
-      }
+Result solvePartOne(const string &input) {
+  return solve(input, 1);
+}
 
-      return calcCombinations(records, groups);
-    });
-  return accumulate(rg.begin(), rg.end(), static_cast<int64_t>(0));
+Result solvePartTwo(const string &input) {
+  return solve(input, 5);
 }
 } // namespace aoc12
@@ -1,11 +1,14 @@
 #include <algorithm>
+#include <bit>
 #include <iostream>
 #include <map>
 #include <numeric>
+#include <optional>
 #include <ranges>
 #include <string>
 #include <string_view>
 #include <vector>
+#include <cstdint>
 
 #include "aoc.h"
 #include "utils.h"
@@ -15,71 +18,81 @@ namespace aoc13 {
 using namespace std;
 using namespace aoc;
 
-// Checks whether the strings are different by a single position
-// returning the position where they differ if so
-int diffsBySinglePos(const string &str1, const string &str2) {
-  if (str1.size() != str2.size()) return -1;
-  int diff = -1;
-  for (int i = 0; i < str1.size(); i++) {
-    if (str1[i] != str2[i]) {
-      if (diff != -1) return -1;  // Previously found a diff
-      diff = i;
+// Pattern encoded as bitmasks of its rows and of its columns, which limits it to 64x64
+struct Pattern {
+  vector<uint64_t> rows, cols;
+};
+
+constexpr int MaxSize = 64;
+
+// Encodes the pattern in a single pass, setting a bit for each '#', or nullopt if it's too big
+optional<Pattern> encodePattern(string_view pattern) {
+  auto ret = Pattern{};
+  int y = 0;
+  for (auto line : pattern | splitString('\n')) {
+    if (y >= MaxSize || line.size() > MaxSize) return nullopt;
+    ret.rows.push_back(0);
+    ret.cols.resize(line.size());
+    for (int x = 0; x < line.size(); x++) {
+      uint64_t rock = line[x] == '#';
+      ret.rows[y] |= rock << x;
+      ret.cols[x] |= rock << y;
     }
+    y++;
   }
-  return diff;
+  return ret;
 }
 
-// Tries to find a reflection row on the pattern.
-// If allowSingleDiffs = true, allows for single character changes
-pair<int, vec2<int>> findReflectionRow(const vector<string> &pattern, bool allowSingleDiffs = false) {
-  int h = pattern.size();
-  for (int row = 1; row < h; row++) {
-    bool reflected = true;
-    auto diffPos = vec2<int>{ -1, -1 };
-    // Check if rows are reflected around current one
-    for (int i = 0; i < min(row, h - row); i++) {
-      if (pattern[row + i] != pattern[row - i - 1]) {
-        // Different row, no reflection in principle, but check for single diffs rules
-        if (allowSingleDiffs && (diffPos.x == -1)) {
-          // Single diffs allowed and no single diff previously detected. 
-          // Check if this row has a single diff
-          int diffCol = diffsBySinglePos(pattern[row + i], pattern[row - i - 1]);
-          if (diffCol != -1) {
-            diffPos = vec2<int>{ diffCol, row-i-1 };
-            continue;
-          }
-        }
-        reflected = false;
-        break;
-      }
+/**
+ * Finds the line before which the masks are reflected with exactly `smudges`
+ * differing positions, counting the different bits of each reflected pair
+ *
+ * @param masks Rows or columns of the pattern
+ * @param smudges Number of positions that must differ
+ * @return Number of lines before the reflection, or 0 if there's none
+*/
+int findReflection(const vector<uint64_t> &masks, int smudges) {
+  int n = masks.size();
+  for (int line = 1; line < n; line++) {
+    int diffs = 0;
+    for (int i = 0; i < min(line, n - line) && diffs <= smudges; i++) {
+      diffs += popcount(masks[line + i] ^ masks[line - i - 1]);
     }
-    if (reflected && (!allowSingleDiffs || diffPos.x != -1)) 
-      return make_pair(row, diffPos);
+    if (diffs == smudges) return line;
   }
-  return make_pair(-1, vec2<int>(-1, -1));
+  return 0;
 }
 
+/**
+ * Summarizes the patterns, which are split between threads
+ *
+ * @param input Input
+ * @param smudges Number of smudges on each pattern
+ * @return Sum of the reflection lines, or nothing if a pattern is bigger than 64x64
+*/
+Result solve(const string &input, int smudges = 0) {
+  auto patterns = toVector(input | splitString<string_view, string>("\n\n"));
 
-Result solve(const string &input, bool allowSingleDiffs = false) {
-  auto rg = input 
-    | splitString<string_view, string>("\n\n")
-    | views::transform([](auto pattern) {
-        return toVector(pattern | splitString<string>('\n'));
-      })
-    | views::transform([allowSingleDiffs](auto pattern) {
-        auto [row, _ignore1] = findReflectionRow(pattern, allowSingleDiffs);
-        auto [col, _ignore2] = findReflectionRow(transposeBoard(pattern), allowSingleDiffs);
-        return (row != -1) ? row * 100 : col;
-    });
-
-  return accumulate(rg.begin(), rg.end(), (int64_t)0);
+  auto total = parallelReduce(patterns.size(), optional<int64_t>{0}, [&patterns, smudges](size_t i) -> optional<int64_t> {
+    auto pattern = encodePattern(patterns[i]);
+    if (!pattern) return nullopt;
+    auto row = findReflection(pattern->rows, smudges);
+    return (row != 0) ? row * 100 : findReflection(pattern->cols, smudges);
+  }, [](optional<int64_t> a, optional<int64_t> b) -> optional<int64_t> {
+    if (!a || !b) return nullopt;
+    return *a + *b;
+  });
+  if (total)
+    return *total;
+  else
+    return monostate();
 }
 
 Result solvePartOne(const string &input) {
-  return solve(input, false);
+  return solve(input, 0);
 }
 
 Result solvePartTwo(const string &input) {
-  return solve(input, true);
+  return solve(input, 1);
 }
 } // namespace aoc13
@@ -6,9 +6,7 @@
 #include <string>
 #include <string_view>
 #include <vector>
-#include <sstream>
-#include <unordered_map>
-#include <format>
+#include <cstdint>
 
 #include "aoc.h"
 #include "utils.h"
@@ -18,94 +16,133 @@ namespace aoc14 {
 using namespace std;
 using namespace aoc;
 
-using Dir = vec2<int>;
-using Pos = vec2<int>;
-
-// Standard directions and invalid marker
-constexpr auto 
-  NORTH = Dir(0, -1),
-  SOUTH = Dir(0, 1),
-  EAST = Dir(1, 0),
-  WEST = Dir(-1, 0);
-
-constexpr char ROCK = 'O', CUBE = '#', EMPTY = '.';
-
-void tiltBoard(vector<string> &board, const Dir dir) {
-  auto h = (int)board.size(), w = (int)board[0].size();
-  bool tiltHorizontal = (dir.y == 0);
-
-  // Loop according to dir: starting from the start or end, so that we don't overwrite positions
-  int dy = (dir.y == 1) ? -1 : 1, dx = (dir.x == 1) ? -1 : 1;
-  int sy = (dir.y == 1) ? h - 1 : 0, sx = (dir.x == 1) ? w - 1 : 0;
-  // Save the last empty position for each row or column
-  auto lastEmpty = vector<Pos>(tiltHorizontal ? h : w);
-  for (int i = 0; i < lastEmpty.size(); i++) {
-    lastEmpty[i] = tiltHorizontal ? Pos(sx, i) : Pos(i, sy);
-  }
-  // Loop up/down
-  for (int y = sy; y >= 0 && y < h; y += dy) {
-    // Loop left/right
-    for (int x = sx; x >= 0 && x < w; x += dx) {
-      int emptyIdx = tiltHorizontal ? y : x;
-      if (board[y][x] == CUBE) {
-        // Update last empty position
-        lastEmpty[emptyIdx].y = y - dir.y;
-        lastEmpty[emptyIdx].x = x - dir.x;
-      } else if (board[y][x] == ROCK) {
-        // Clear and place rock on last empty position
-        board[y][x] = EMPTY;
-        board[lastEmpty[emptyIdx].y][lastEmpty[emptyIdx].x] = ROCK;
-        lastEmpty[emptyIdx] -= dir;
-      }
+constexpr char ROCK = 'O', CUBE = '#';
+
+// Stretch [from, to) of a line between cubes, where rocks slide
+struct Segment {
+  int line, from, to;
+};
+
+/**
+ * Dish with the rocks as bitboards, both in rows (bit x of line y) for tilting
+ * East/West and in columns (bit y of line x) for tilting North/South, and the
+ * segments between cubes on each of them. Rocks are transposed between the two
+ * as needed, so that tilts always slide rocks along a line
+*/
+struct Dish {
+  int w, h;
+  BitGrid rows, cols;
+  vector<Segment> rowSegments, colSegments;
+};
+
+// Segments between cubes on each line of a cubes bitboard
+vector<Segment> findSegments(const BitGrid &cubes) {
+  auto ret = vector<Segment>{};
+  for (int y = 0; y < cubes.height; y++) {
+    int from = 0;
+    for (int x = 0; x <= cubes.width; x++) {
+      if (x < cubes.width && !cubes.test(x, y)) continue;
+      if (x > from) ret.push_back(Segment{y, from, x});
+      from = x + 1;
     }
   }
+  return ret;
 }
 
-int64_t scoreBoard(const auto &board) {
-  auto h = (int)board.size(), w = (int)board[0].size();
-  auto res = int64_t{ 0 };
+Dish parseInput(const string &input) {
+  auto lines = toVector(input | splitString('\n'));
+  int h = lines.size(), w = lines[0].size();
+
+  auto cubes = BitGrid(w, h), cubesCols = BitGrid{};
+  auto dish = Dish{w, h, BitGrid(w, h), BitGrid{}, {}, {}};
   for (int y = 0; y < h; y++) {
     for (int x = 0; x < w; x++) {
-      res += (board[y][x] == ROCK) * (h - y);
+      if (lines[y][x] == ROCK) dish.rows.set(x, y);
+      if (lines[y][x] == CUBE) cubes.set(x, y);
     }
   }
-  return res;
+  cubes.transposeInto(cubesCols);
+  dish.rowSegments = findSegments(cubes);
+  dish.colSegments = findSegments(cubesCols);
+  return dish;
+}
+
+/**
+ * Tilts the rocks in a bitboard along its lines: for each segment, count its rocks
+ * and fill that many bits from the start (or end) of the segment
+ *
+ * @param rocks Rocks bitboard
+ * @param segments Segments between cubes
+ * @param towardsStart Whether to slide towards the start or the end of the lines
+*/
+void tilt(BitGrid &rocks, const vector<Segment> &segments, bool towardsStart) {
+  for (const auto &s : segments) {
+    int count = rocks.count(s.line, s.from, s.to);
+    if (count == 0 || count == s.to - s.from) continue;
+    rocks.assign(s.line, s.from, s.to, false);
+    if (towardsStart) rocks.assign(s.line, s.from, s.from + count, true);
+    else rocks.assign(s.line, s.to - count, s.to, true);
+  }
 }
 
-// Flatten board to string, to be used as key in cache
-inline string flattenBoard(const auto &board) {
-  ostringstream flattened;
-  copy(board.begin(), board.end(), ostream_iterator<string>(flattened));
-  return flattened.str();
+// A spin cycle: North, West, South, East. Starts and ends with the rocks on rows
+void spin(Dish &dish) {
+  dish.rows.transposeInto(dish.cols);
+  tilt(dish.cols, dish.colSegments, true);
+  dish.cols.transposeInto(dish.rows);
+  tilt(dish.rows, dish.rowSegments, true);
+  dish.rows.transposeInto(dish.cols);
+  tilt(dish.cols, dish.colSegments, false);
+  dish.cols.transposeInto(dish.rows);
+  tilt(dish.rows, dish.rowSegments, false);
 }
 
+// Load on the north support beams, from the rocks on rows
+int64_t scoreBoard(const Dish &dish) {
+  auto res = int64_t{ 0 };
+  for (int y = 0; y < dish.h; y++) {
+    res += (int64_t)dish.rows.count(y, 0, dish.w) * (dish.h - y);
+  }
+  return res;
+}
+
+// 128 bit hash of the rocks, accumulated word by word with a multiplicative mix
+unsigned __int128 hashRocks(const BitGrid &rocks) {
+  constexpr auto mult = ((unsigned __int128)0x9E3779B97F4A7C15 << 64) | 0xC2B2AE3D27D4EB4F;
+  auto ret = (unsigned __int128)rocks.words.size();
+  for (auto w : rocks.words) ret = (ret ^ (w * 0xFF51AFD7ED558CCD)) * mult + (ret >> 71);
+  return ret;
+}
 
 Result solvePartOne(const string &input) {
-  auto board = toVector(input | splitString<string>('\n'));
-  tiltBoard(board, NORTH);
-  return scoreBoard(board);
+  auto dish = parseInput(input);
+  dish.rows.transposeInto(dish.cols);
+  tilt(dish.cols, dish.colSegments, true);
+  dish.cols.transposeInto(dish.rows);
+  return scoreBoard(dish);
 }
 
 Result solvePartTwo(const string &input) {
-  auto board = toVector(input | splitString<string>('\n'));
-  // Cache of boards and the loop index that generated them
-  auto cache = unordered_map<string, int>{};
-
-  const auto dirs = vector<Dir>{NORTH, WEST, SOUTH, EAST};
-  auto steps = int64_t{ 1000000000 };
-  bool cycleFound = false;
-  for (int64_t i = 0; i < steps; i++) {
-    ranges::for_each(dirs, [&board](auto d) { tiltBoard(board, d); });
-    if (cycleFound) continue;   // We're just looping on the remainder steps
-    auto key = flattenBoard(board);
-    if (cache.contains(key)) {  // Cycle found, increase counter to remaining steps
-      cycleFound = true;
-      i = steps - (steps - cache[key]) % (i - cache[key]);
-      continue;
+  auto dish = parseInput(input);
+
+  // Brent's cycle detection, keeping only the hash of the tortoise. When a cycle
+  // of length `period` is found, the remaining spins are reduced modulo it
+  const auto spins = int64_t{ 1000000000 };
+  int64_t power = 1, period = 1, i = 1;
+  auto tortoise = hashRocks(dish.rows);
+  spin(dish);
+  for (; i < spins && hashRocks(dish.rows) != tortoise; i++, period++) {
+    if (power == period) {
+      tortoise = hashRocks(dish.rows);
+      power *= 2;
+      period = 0;
     }
-    cache[key] = i;
+    spin(dish);
+  }
+  for (int64_t remaining = (i < spins) ? (spins - i) % period : 0; remaining > 0; remaining--) {
+    spin(dish);
   }
 
-  return scoreBoard(board);
+  return scoreBoard(dish);
 }
 } // namespace aoc14
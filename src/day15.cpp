@@ -1,11 +1,14 @@
 #include <algorithm>
+#include <array>
 #include <iostream>
 #include <map>
 #include <numeric>
 #include <ranges>
 #include <string>
 #include <string_view>
+#include <unordered_map>
 #include <vector>
+#include <cstdint>
 
 #include "aoc.h"
 #include "utils.h"
@@ -19,48 +22,119 @@ int64_t dayHash(const string_view s) {
   return accumulate(s.begin(), s.end(), (int64_t)0, [](auto prev, auto c) { return (c == '\n') ? prev : ((prev + c) * 17 % 256); });
 }
 
+/**
+ * Sum of the hashes of all steps. The input is split in chunks (at step boundaries),
+ * one for each lane, and the lanes are advanced in lock step one character at a
+ * time, so that the independent hash computations are interleaved. Hashes are kept
+ * as uint8_t, so the modulo is implicit
+ *
+ * @param input Comma separated steps
+ * @return Sum of the hashes
+*/
+template<int Lanes = 16>
+int64_t hashSum(string_view input) {
+  auto begin = array<size_t, Lanes + 1>{}, pos = array<size_t, Lanes>{};
+  for (int l = 1; l < Lanes; l++) {
+    begin[l] = max(begin[l - 1], min(input.find(',', input.size() * l / Lanes), input.size()));
+  }
+  begin[Lanes] = input.size();
+
+  size_t maxLen = 0;
+  for (int l = 0; l < Lanes; l++) {
+    pos[l] = begin[l];
+    maxLen = max(maxLen, begin[l + 1] - begin[l]);
+  }
+
+  auto hash = array<uint8_t, Lanes>{};
+  auto sum = array<int64_t, Lanes>{};
+  for (size_t i = 0; i < maxLen; i++) {
+    for (int l = 0; l < Lanes; l++) {
+      char c = (pos[l] < begin[l + 1]) ? input[pos[l]++] : '\n';
+      bool endStep = c == ',', skip = c == '\n';
+      sum[l] += endStep ? hash[l] : 0;
+      hash[l] = endStep ? 0 : skip ? hash[l] : (uint8_t)((hash[l] + c) * 17);
+    }
+  }
+  // The last step of each lane isn't followed by a ','
+  for (int l = 0; l < Lanes; l++) sum[l] += hash[l];
+  return accumulate(sum.begin(), sum.end(), (int64_t)0);
+}
+
 Result solvePartOne(const string &input) {
-  auto steps = input
-    | splitString(',')
-    | views::transform(dayHash);
-  return accumulate(steps.begin(), steps.end(), (int64_t)0);
+  return hashSum(input);
 }
 
 // Returns the components of the given step
 inline tuple<string_view, char, int>destructure(const string_view step) {
   size_t idx = 0;
-  for (idx = 0; idx < step.size(); idx++) 
+  for (idx = 0; idx < step.size(); idx++)
     if (step[idx] == '-' || step[idx] == '=') break;
   return make_tuple(step.substr(0, idx), step[idx], (idx + 1 >= step.size()) ? 0 : ston<int>(step.substr(idx + 1)));
 }
 
+/**
+ * Boxes of lenses, keeping the insertion order of each box. Lenses are stored in a
+ * single vector, and each box keeps the ids of its lenses in order. A map from label
+ * to the id of its current lens gives O(1) lookups. Removing a lens just marks it as
+ * removed (tombstone), which are skipped when scoring
+*/
+class LensBoxes {
+public:
+  void insert(string_view label, int focal) {
+    auto [it, inserted] = labels.try_emplace(label, (uint32_t)lenses.size());
+    if (!inserted) {
+      lenses[it->second].focal = focal;
+      return;
+    }
+    auto box = dayHash(label);
+    lenses.push_back(Lens{focal, true});
+    boxes[box].push_back(it->second);
+  }
+
+  void remove(string_view label) {
+    auto it = labels.find(label);
+    if (it == labels.end()) return;
+    lenses[it->second].present = false;
+    labels.erase(it);
+  }
+
+  // Focusing power, compacting the boxes to skip removed lenses
+  int64_t focusingPower() {
+    auto res = int64_t{ 0 };
+    for (size_t i = 0; i < boxes.size(); i++) {
+      erase_if(boxes[i], [this](uint32_t id) { return !lenses[id].present; });
+      for (size_t j = 0; j < boxes[i].size(); j++) {
+        res += (int64_t)(i + 1) * (int64_t)(j + 1) * lenses[boxes[i][j]].focal;
+      }
+    }
+    return res;
+  }
+
+private:
+  struct Lens {
+    int focal;
+    bool present;
+  };
+
+  vector<Lens> lenses;
+  array<vector<uint32_t>, 256> boxes;
+  unordered_map<string_view, uint32_t> labels;
+};
+
 Result solvePartTwo(const string &input) {
   auto steps = input
     | splitString(',');
-  auto boxes = vector<vector<pair<string_view, int>>>(256);
 
+  auto boxes = LensBoxes{};
   for (auto s : steps) {
     auto [label, op, val] = destructure(s);
-    auto &box = boxes[dayHash(label)];
-    auto it = ranges::find_if(box, [&label](auto p) { return p.first == label; });
     if (op == '=') {
-      if (it != box.end()) {
-        it->second = val;
-      } else {
-        box.push_back(make_pair(label, val));
-      }
-    } else if (it != box.end()) {
-        box.erase(it);
-    }
-  }
-
-  auto res = int64_t{ 0 };
-  for (int i = 0; i < boxes.size(); i++) {
-    for (int j = 0; j < boxes[i].size(); j++) {
-      res += (i+1) * (j+1) * boxes[i][j].second;
+      boxes.insert(label, val);
+    } else {
+      boxes.remove(label);
     }
   }
 
-  return res;
+  return boxes.focusingPower();
 }
 } // namespace aoc15
@@ -1,4 +1,6 @@
 #include <algorithm>
+#include <array>
+#include <bit>
 #include <iostream>
 #include <map>
 #include <numeric>
@@ -6,8 +8,7 @@
 #include <string>
 #include <string_view>
 #include <vector>
-#include <unordered_map>
-#include <format>
+#include <cstdint>
 
 #include "aoc.h"
 #include "utils.h"
@@ -17,93 +18,265 @@ namespace aoc16 {
 using namespace std;
 using namespace aoc;
 
-using Pos = vec2<int>;
-using Dir = vec2<int>;
-
-// Directions
-constexpr auto 
-  NORTH = Dir(0, -1),
-  SOUTH = Dir(0, 1),
-  EAST = Dir(1, 0),
-  WEST = Dir(-1, 0);
-
-int64_t countEnergized(const vector<string_view> &grid, Pos startPos, Dir startDir) {
-  auto h = (int)grid.size(), w = (int)grid[0].size();
-  // char visitedGrid[h][w]{};
-  auto visitedGrid = vector(h, vector<char>(w, 0));
-  // Keep a list of rays currently traveling
-  auto rays = vector<pair<Pos, Dir>>{ make_pair(startPos, startDir) };
-  auto energized = int64_t{ 0 };
-  while (!rays.empty()) {
-    auto [pos, dir] = rays.back();
-    rays.pop_back();
-    // Bit vector with different bits set for different directions
-    char dirBits = 1 << ((dir.x + 1) * 2 + (dir.y + 1));
-
-    // Outside board or already visited in the same direction
-    if (!inBounds(pos.x, 0, w) || !inBounds(pos.y, 0, h) || (visitedGrid[pos.y][pos.x] & dirBits)) 
-      continue;
-
-    // Follow empty spaces, in the same dir
-    while (inBounds(pos.x, 0, w) && inBounds(pos.y, 0, h)) {
-      auto c = grid[pos.y][pos.x];
-      // Count energized if not visited and mark visited
-      if (!visitedGrid[pos.y][pos.x]) energized++;
-      visitedGrid[pos.y][pos.x] |= dirBits;
-
-      // Keep going if possible
-      if (c == '.' || (c == '-' && dir.y == 0) || (c == '|' && dir.x == 0)) {
-        pos += dir;
-      } else {
-        break;
+// Directions, clockwise, and their offsets
+enum Dir { NORTH, EAST, SOUTH, WEST };
+constexpr int dx[] = { 0, 1, 0, -1 }, dy[] = { -1, 0, 1, 0 };
+
+/**
+ * Graph of the beam segments. A node is a beam starting on a cell and going in a
+ * direction until it reaches a junction that changes its direction (a mirror, or a
+ * splitter hit on its flat side) or leaves the grid. Nodes start either after a
+ * junction or on the border, for the entries. Each segment is a straight line, so
+ * it's stored as its start, direction and length, and its successors are the beams
+ * leaving the junction where it ends
+*/
+struct BeamGraph {
+  struct Node {
+    int start, dir, length;
+    array<int, 2> next{-1, -1};
+  };
+
+  int w, h;
+  vector<Node> nodes;
+};
+
+/**
+ * Condensation of the beam graph into its strongly connected components, as all
+ * nodes in a cycle energize the same tiles. Each component stores the tiles of its
+ * own segments as a compressed bitset (only the non-zero words, with their index),
+ * and the components it leads to
+*/
+struct Condensed {
+  vector<int> componentOf;
+  vector<vector<pair<uint32_t, uint64_t>>> tiles;
+  vector<vector<int>> next;
+  int words;
+};
+
+class BeamGraphBuilder {
+public:
+  BeamGraphBuilder(string_view grid) : grid{grid} {
+    graph.w = grid.find('\n');
+    graph.h = (grid.size() + 1) / (graph.w + 1);
+    junctionNodes.assign(graph.w * graph.h * 4, -1);
+  }
+
+  // Adds an entry beam on the border, returning its node
+  int addEntry(int x, int y, int dir) {
+    graph.nodes.push_back(BeamGraph::Node{y * graph.w + x, dir, 0});
+    int id = graph.nodes.size() - 1;
+    build(id);
+    return id;
+  }
+
+  BeamGraph &result() { return graph; }
+
+private:
+  string_view grid;
+  BeamGraph graph;
+  // Node of the beam leaving each junction cell in each direction
+  vector<int> junctionNodes;
+
+  char cell(int x, int y) const { return grid[y * (graph.w + 1) + x]; }
+
+  // Node for the beam leaving a junction cell in a direction, creating it if needed
+  int junctionNode(int x, int y, int dir, vector<int> &pending) {
+    auto &id = junctionNodes[(y * graph.w + x) * 4 + dir];
+    if (id == -1) {
+      int nx = x + dx[dir], ny = y + dy[dir];
+      bool inside = inBounds(nx, 0, graph.w) && inBounds(ny, 0, graph.h);
+      graph.nodes.push_back(BeamGraph::Node{inside ? ny * graph.w + nx : -1, dir, 0});
+      id = graph.nodes.size() - 1;
+      if (inside) pending.push_back(id);
+    }
+    return id;
+  }
+
+  // Traces the segments of all nodes reachable from a new one
+  void build(int first) {
+    auto pending = vector<int>{first};
+    while (!pending.empty()) {
+      int id = pending.back();
+      pending.pop_back();
+      auto &node = graph.nodes[id];
+      int dir = node.dir, x = node.start % graph.w, y = node.start / graph.w;
+      // Follow the beam while it isn't redirected
+      for (int len = 1; ; len++, x += dx[dir], y += dy[dir]) {
+        graph.nodes[id].length = len;
+        char c = cell(x, y);
+        bool vertical = dir == NORTH || dir == SOUTH;
+        auto outs = array<int, 2>{-1, -1};
+        if (c == '/') outs[0] = dir ^ 1;
+        else if (c == '\\') outs[0] = 3 - dir;
+        else if (c == '|' && !vertical) outs = {NORTH, SOUTH};
+        else if (c == '-' && vertical) outs = {EAST, WEST};
+
+        if (outs[0] != -1) {
+          for (int i = 0; i < 2; i++) {
+            if (outs[i] != -1) {
+              int next = junctionNode(x, y, outs[i], pending);
+              graph.nodes[id].next[i] = next;
+            }
+          }
+          break;
+        }
+        if (!inBounds(x + dx[dir], 0, graph.w) || !inBounds(y + dy[dir], 0, graph.h)) break;
       }
     }
+  }
+};
 
-    if (!inBounds(pos.x, 0, w) || !inBounds(pos.y, 0, h)) continue;
-    auto c = grid[pos.y][pos.x];
-    // We're at a junction, change direction of ray
-    if (c == '\\') {
-      auto newDir = Dir(dir.y, dir.x);
-      rays.push_back(make_pair(pos + newDir, newDir));
-    } else if (c == '/') {
-      auto newDir = Dir(-dir.y, -dir.x);
-      rays.push_back(make_pair(pos + newDir, newDir));
-    } else if (c == '|') {
-      auto newDir1 = Dir(0, 1), newDir2 = Dir(0, -1);
-      rays.push_back(make_pair(pos + newDir1, newDir1));
-      rays.push_back(make_pair(pos + newDir2, newDir2));
-    } else if (c == '-') {
-      auto newDir1 = Dir(1, 0), newDir2 = Dir(-1, 0);
-      rays.push_back(make_pair(pos + newDir1, newDir1));
-      rays.push_back(make_pair(pos + newDir2, newDir2));
+/**
+ * Condenses the graph with Tarjan's algorithm (iterative, as cycles can be long),
+ * and collects the tiles of each component
+ *
+ * @param graph Beam graph
+ * @return Condensed graph
+*/
+Condensed condense(const BeamGraph &graph) {
+  int n = graph.nodes.size();
+  auto ret = Condensed{vector<int>(n, -1), {}, {}, (graph.w * graph.h + 63) / 64};
+
+  auto index = vector<int>(n, -1), low = vector<int>(n, 0), stack = vector<int>{};
+  auto onStack = vector<bool>(n, false);
+  // Call stack of (node, next successor to visit)
+  auto calls = vector<pair<int, int>>{};
+  int counter = 0;
+  for (int root = 0; root < n; root++) {
+    if (index[root] != -1) continue;
+    calls.push_back({root, 0});
+    while (!calls.empty()) {
+      auto &[v, i] = calls.back();
+      if (i == 0) {
+        index[v] = low[v] = counter++;
+        stack.push_back(v);
+        onStack[v] = true;
+      }
+      if (i < 2) {
+        int next = graph.nodes[v].next[i++];
+        if (next == -1) continue;
+        if (index[next] == -1) {
+          calls.push_back({next, 0});
+        } else if (onStack[next]) {
+          low[v] = min(low[v], index[next]);
+        }
+        continue;
+      }
+
+      // All successors visited, close component if v is its root
+      int node = v;
+      calls.pop_back();
+      if (!calls.empty()) low[calls.back().first] = min(low[calls.back().first], low[node]);
+      if (low[node] != index[node]) continue;
+      int component = ret.tiles.size();
+      ret.tiles.emplace_back();
+      ret.next.emplace_back();
+      int member;
+      do {
+        member = stack.back();
+        stack.pop_back();
+        onStack[member] = false;
+        ret.componentOf[member] = component;
+      } while (member != node);
     }
   }
-  return energized;
+
+  // Tiles of the segments on each component, and edges between components
+  auto members = vector<vector<int>>(ret.tiles.size());
+  for (int v = 0; v < n; v++) members[ret.componentOf[v]].push_back(v);
+  auto dense = vector<uint64_t>(ret.words);
+  auto touched = vector<uint32_t>{};
+  for (int c = 0; c < members.size(); c++) {
+    for (int v : members[c]) {
+      const auto &node = graph.nodes[v];
+      for (int i = 0, x = node.start % graph.w, y = node.start / graph.w; i < node.length; i++, x += dx[node.dir], y += dy[node.dir]) {
+        int tile = y * graph.w + x;
+        if (dense[tile / 64] == 0) touched.push_back(tile / 64);
+        dense[tile / 64] |= uint64_t{1} << (tile % 64);
+      }
+      for (int next : node.next) {
+        if (next != -1 && ret.componentOf[next] != c) ret.next[c].push_back(ret.componentOf[next]);
+      }
+    }
+    ranges::sort(touched);
+    for (auto word : touched) {
+      ret.tiles[c].push_back({word, dense[word]});
+      dense[word] = 0;
+    }
+    touched.clear();
+  }
+  return ret;
 }
 
+/**
+ * Counts energized tiles from an entry as the union of the tiles of all components
+ * reachable from it. Buffers are kept between calls, so one evaluator per thread
+ * can process many entries
+*/
+class EnergizedCounter {
+public:
+  EnergizedCounter(const Condensed &graph) : graph{graph},
+    stamp(graph.tiles.size(), 0), energized(graph.words) {}
+
+  int64_t count(int entryNode) {
+    generation++;
+    int first = graph.componentOf[entryNode];
+    stack.push_back(first);
+    stamp[first] = generation;
+    while (!stack.empty()) {
+      int c = stack.back();
+      stack.pop_back();
+      for (auto [word, bits] : graph.tiles[c]) energized[word] |= bits;
+      for (int next : graph.next[c]) {
+        if (stamp[next] != generation) {
+          stamp[next] = generation;
+          stack.push_back(next);
+        }
+      }
+    }
+
+    int64_t ret = 0;
+    for (auto &word : energized) {
+      ret += popcount(word);
+      word = 0;
+    }
+    return ret;
+  }
+
+private:
+  const Condensed &graph;
+  uint32_t generation = 0;
+  vector<uint32_t> stamp;
+  vector<int> stack;
+  vector<uint64_t> energized;
+};
+
 Result solvePartOne(const string &input) {
-  auto grid = toVector(input | splitString('\n'));
-  return countEnergized(grid, Pos{0, 0}, EAST);
+  auto builder = BeamGraphBuilder(input);
+  int entry = builder.addEntry(0, 0, EAST);
+  auto graph = condense(builder.result());
+  return EnergizedCounter(graph).count(entry);
 }
 
-
 Result solvePartTwo(const string &input) {
-  auto grid = toVector(input | splitString('\n'));
+  auto builder = BeamGraphBuilder(input);
+  int w = builder.result().w, h = builder.result().h;
 
   // Entry points along border
-  auto entries = vector<pair<Pos, Dir>>{};
-  int h = grid.size(), w = grid[0].size();
+  auto entries = vector<int>{};
   for (int y = 0; y < h; y++) {
-    entries.push_back(make_pair(Pos{0, y}, EAST));
-    entries.push_back(make_pair(Pos{w - 1, y}, WEST));
+    entries.push_back(builder.addEntry(0, y, EAST));
+    entries.push_back(builder.addEntry(w - 1, y, WEST));
   }
   for (int x = 0; x < w; x++) {
-    entries.push_back(make_pair(Pos{x, 0}, SOUTH));
-    entries.push_back(make_pair(Pos{x, h - 1}, NORTH));
+    entries.push_back(builder.addEntry(x, 0, SOUTH));
+    entries.push_back(builder.addEntry(x, h - 1, NORTH));
   }
+  auto graph = condense(builder.result());
 
-  return foldLeft(entries, (int64_t)0, [&grid](auto m, auto entry) { 
-      return max(m, countEnergized(grid, entry.first, entry.second)); 
-    });
+  // Entries are split between threads, each with its own counter
+  return parallelReduce(entries.size(), (int64_t)0, [&graph]() { return EnergizedCounter(graph); },
+    [&entries](EnergizedCounter &counter, size_t i) { return counter.count(entries[i]); },
+    [](int64_t a, int64_t b) { return max(a, b); });
 }
 } // namespace aoc16
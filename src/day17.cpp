@@ -6,11 +6,7 @@
 #include <string>
 #include <string_view>
 #include <vector>
-#include <functional>
-#include <deque>
-#include <queue>
-#include <unordered_set>
-#include <format>
+#include <cstdint>
 
 #include "aoc.h"
 #include "utils.h"
@@ -20,96 +16,62 @@ namespace aoc17 {
 using namespace std;
 using namespace aoc;
 
-using Grid = vector<vector<int>>;
-using Pos = vec2<int>;
-using Dir = vec2<int>;
-
-Grid parseInput(const string &input) {
-  return toVector(input
-    | splitString('\n')
-    | views::transform([](auto line) {
-      return toVector(line | views::transform([](auto c) { return c - '0'; }));
-      })
-  );
-}
-
-struct State {
-  Pos pos;
-  Dir dir;
-  int cost;
-  // int prev = -1;
-
-  bool operator==(const State &other) const {
-    return (pos == other.pos) &&
-      (dir == other.dir);
-  };
-  auto operator<(const State &other) const {
-    return cost < other.cost;
-  };
+// Heat loss of each block, in a flat row-major grid
+struct Grid {
+  int w, h;
+  vector<uint8_t> cost;
 };
 
-std::ostream & operator<<(std::ostream &os, const State &s) {
-	os << "Pos: " << s.pos << ", Dir: " << s.dir << ", Cost: " << s.cost;
-	return os;
-}
-
-// Rotates clockwise/counterclockwise
-inline Dir rotate(const Dir &pos, int dir = 1) { 
-  return Dir(pos.y * dir, pos.x * (-dir));
-}
-
-auto successors(const State &state, const auto &grid, int minSteps, int maxSteps) {
-  auto successors = vector<State>{};
-  // Generate all possible successors: turns between minSteps and maxSteps
-  int cost = state.cost;
-  auto pos = state.pos + state.dir;
-  for (int i = 1; i <= maxSteps && insideBoard(grid, pos); i++, pos += state.dir) {
-    cost += grid[pos.y][pos.x];
-    if (i < minSteps) continue;
-    // Add turns
-    auto turnLeft = rotate(state.dir, 1), turnRight = rotate(state.dir, -1);
-    successors.push_back(State(pos, turnLeft, cost));
-    successors.push_back(State(pos, turnRight, cost));
+Grid parseInput(const string &input) {
+  auto grid = Grid{(int)input.find('\n'), 0, {}};
+  for (char c : input) {
+    if (c != '\n') grid.cost.push_back(c - '0');
   }
-  return successors;
-};
-
-inline int dirIdx(Dir d) { return abs(d.x) * 2 + (d.x + 1) / 2 + (d.y + 1) / 2; };
+  grid.h = grid.cost.size() / grid.w;
+  return grid;
+}
 
+/**
+ * Minimum heat loss from the top left to the bottom right block. Instead of moving
+ * one block at a time, each move goes straight between minSteps and maxSteps blocks
+ * and then turns, so a state is just the block and the axis of the last move
+ * (state = block * 2 + axis, 0 for horizontal and 1 for vertical), as the next
+ * move is always along the other axis. Uses A* with the Manhattan distance to the
+ * end, which never overestimates: a move covers several blocks, but each block it
+ * enters costs at least 1, and the end is at least that many blocks away
+ *
+ * @param input Input
+ * @param minSteps Minimum blocks to move in a straight line
+ * @param maxSteps Maximum blocks to move in a straight line
+ * @return Minimum heat loss
+*/
 Result solve(const string &input, int minSteps = 1, int maxSteps = 3) {
   auto grid = parseInput(input);
-  auto h = grid.size(), w = grid[0].size();
+  int w = grid.w, h = grid.h, goal = w * h - 1;
 
-  auto finalPos = Pos{(int)w - 1, (int)h - 1};
-  auto startEast = State{Pos{0, 0}, Dir{1, 0}, 0}, 
-       startSouth = State{Pos{0, 0}, Dir{0, 1}, 0};
-  auto comparisonFn = [](const State &s1, const State &s2) noexcept {
-    return s1.cost > s2.cost;     // Minimum cost
-  };
-  // priority_queue<State, vector<State>, decltype(comparisonFn)> frontier { comparisonFn, vector{startSouth, startEast}};
-  auto frontier = vector<vector<State>>(2000, {startSouth, startEast});
-  auto reached = vector(h, vector(w, vector<int>(4, { INT32_MAX })));
-  // Djikstra search
-  for (auto costIdx = 0; costIdx < frontier.size(); costIdx++) {
-    for (auto current : frontier[costIdx])  {
-        // Check if we can reach the current node with strictly smaller cost
-      if (current.cost > reached[current.pos.y][current.pos.x][dirIdx(current.dir)]) continue;
-      if (current.pos == finalPos) {
-        return current.cost;
-      }
-      for (auto next : successors(current, grid, minSteps, maxSteps)) {
-        // Check if we can already reach the next node with smaller cost
-        auto &prevCost = reached[next.pos.y][next.pos.x][dirIdx(next.dir)];
-        if (next.cost >= prevCost) continue;
-        prevCost = next.cost;
-        if (next.cost > frontier.size()) {
-          frontier.resize(next.cost * 1.5);
-        }
-        frontier[next.cost].push_back(next);
+  auto successors = [&grid, w, h, minSteps, maxSteps](int state, vector<pair<int, int>> &next) {
+    int block = state / 2, x = block % w, y = block / w;
+    bool vertical = (state % 2) == 0;
+    for (int sign : {-1, 1}) {
+      int cost = 0, dx = vertical ? 0 : sign, dy = vertical ? sign : 0;
+      for (int i = 1, nx = x + dx, ny = y + dy;
+          i <= maxSteps && inBounds(nx, 0, w) && inBounds(ny, 0, h);
+          i++, nx += dx, ny += dy) {
+        cost += grid.cost[ny * w + nx];
+        if (i >= minSteps) next.push_back({(ny * w + nx) * 2 + vertical, cost});
       }
     }
-  }
-  return monostate();
+  };
+  auto isGoal = [goal](int state) { return state / 2 == goal; };
+  auto heuristic = [w, h](int state) { return (w - 1 - state / 2 % w) + (h - 1 - state / 2 / w); };
+
+  // A move of k blocks costs at most 9 per block it enters, and changes the Manhattan
+  // distance by at most k, so the priority grows by at most 10 * maxSteps per move
+  auto cost = bucketSearch(grid.cost.size() * 2, {0, 1}, 10 * maxSteps, successors, isGoal, heuristic);
+  if (cost)
+    return *cost;
+  else
+    return monostate();
 }
 
 Result solvePartOne(const string &input) {
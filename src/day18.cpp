@@ -2,12 +2,13 @@
 #include <iostream>
 #include <map>
 #include <numeric>
+#include <optional>
 #include <ranges>
 #include <string>
 #include <string_view>
 #include <vector>
-#include <unordered_map>
-#include <tuple>
+#include <utility>
+#include <cstdint>
 
 #include "aoc.h"
 #include "utils.h"
@@ -17,56 +18,67 @@ namespace aoc18 {
 using namespace std;
 using namespace aoc;
 
-using Instruction = tuple<char, int, string_view>;
-using Dir = vec2<int64_t>;
-using Pos = vec2<int64_t>;
+using int128 = __int128;
 
-vector<Instruction> parseInput(const string &input) {
-  return toVector(input
-    | splitString('\n')
-    | views::transform([](string_view line) {
-      return make_tuple(line.at(0), ston<int>(line.substr(2, line.find(' ', 2) - 2)), line.substr(line.find('(', 2) + 1, 7));
-    }));
-}
+/**
+ * Streaming lagoon area. Each dig instruction updates the current position, the
+ * Shoelace sum (twice the signed area) and the boundary length, so there's no
+ * need to keep the vertices. Sums are kept in 128 bits and checked for overflow
+*/
+class Lagoon {
+public:
+  void dig(char dir, int64_t steps) {
+    int128 dx = (dir == 'R') - (dir == 'L'), dy = (dir == 'D') - (dir == 'U');
+    // Shoelace term x * y' - x' * y, with only one of the coordinates changing
+    int128 term;
+    overflow |= __builtin_mul_overflow(x * dy - y * dx, (int128)steps, &term);
+    overflow |= __builtin_add_overflow(area2, term, &area2);
+    overflow |= __builtin_add_overflow(boundary, (int128)steps, &boundary);
+    x += dx * steps;
+    y += dy * steps;
+  }
+
+  // Pick's theorem gives the interior (A - b/2 + 1), and the boundary is dug too
+  optional<int128> area() const {
+    if (overflow || x != 0 || y != 0) return nullopt;
+    return (area2 < 0 ? -area2 : area2) / 2 + boundary / 2 + 1;
+  }
 
-vector<Pos> getVertices(const vector<Instruction> &inst) {
-  auto dirMap = unordered_map<char, Dir>{ { 'R', Dir{1, 0} }, { 'L', Dir{-1, 0} }, { 'D', Dir{0, 1} }, { 'U', Dir{0, -1} }, };
+private:
+  int128 x = 0, y = 0, area2 = 0, boundary = 0;
+  bool overflow = false;
+};
 
-  auto pos = Pos{0, 0};
-  auto vertices = vector<Pos>{};
-  for (auto [dir, steps, color] : inst) {
-    pos += dirMap[dir] * steps;
-    vertices.push_back(pos);
+/**
+ * Digs both lagoons in a single pass over the input: part one with the direction
+ * and steps, part two with the ones encoded in the color
+ *
+ * @param input Dig plan
+ * @return Lagoons for part one and part two
+*/
+pair<Lagoon, Lagoon> digLagoons(const string &input) {
+  constexpr char colorDirs[] = { 'R', 'D', 'L', 'U' };
+  auto lagoons = pair<Lagoon, Lagoon>{};
+  for (auto line : input | splitString('\n')) {
+    auto colorPos = line.find('#', 2);
+    lagoons.first.dig(line[0], ston<int64_t>(line.substr(2, colorPos - 4)));
+    lagoons.second.dig(colorDirs[line[colorPos + 6] - '0'], ston<int64_t>(line.substr(colorPos + 1, 5), 16));
   }
-  return vertices;
+  return lagoons;
 }
 
-int64_t getArea(vector<Pos> vertices) {
-  // Shoelace formula
-  auto sz = vertices.size();
-  int64_t shoelaces = 0, boundary = 0;
-  for (int i = 0; i < sz; i++) {
-    shoelaces += vertices[i].x * vertices[(i + 1) % sz].y - vertices[(i + 1) % sz].x * vertices[i].y;
-    boundary += vertices[i].manhattanDistanceTo(vertices[(i + 1) % sz]);
-  }
-  shoelaces = abs(shoelaces) / 2;
-  // Pick's
-  int64_t interior = shoelaces - boundary / 2 + 1;
-  return boundary + interior;
+Result toResult(const optional<int128> &area) {
+  if (area && *area <= INT64_MAX)
+    return (int64_t)*area;
+  else
+    return monostate();
 }
 
 Result solvePartOne(const string &input) {
-  return getArea(getVertices(parseInput(input)));
+  return toResult(digLagoons(input).first.area());
 }
 
 Result solvePartTwo(const string &input) {
-  auto inst = parseInput(input);
-
-  auto colorMap = unordered_map<char, char>{ { '0', 'R' }, { '1', 'D' }, { '2', 'L' }, { '3', 'U' }, };
-  auto newInst = vector<Instruction>{};
-  for (auto [dir, steps, color] : inst) {
-    newInst.push_back(Instruction(colorMap[color.back()], ston<int>(color.substr(1, 5), 16), color));
-  }
-  return getArea(getVertices(newInst));
+  return toResult(digLagoons(input).second.area());
 }
 } // namespace aoc18
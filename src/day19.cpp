@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <array>
 #include <iostream>
 #include <map>
 #include <numeric>
@@ -7,6 +8,7 @@
 #include <string_view>
 #include <vector>
 #include <unordered_map>
+#include <cstdint>
 
 #include "aoc.h"
 #include "utils.h"
@@ -16,143 +18,200 @@ namespace aoc19 {
 using namespace std;
 using namespace aoc;
 
-struct Rule {
-  char lhs, op;
-  int rhs;
-  string_view next;
+// Terminal node ids
+constexpr int ACCEPT = -1, REJECT = -2;
+
+/**
+ * A compiled rule: the part goes to node onTrue if sign * (part[category] - value) > 0
+ * (sign is 1 for '>' and -1 for '<'), and to node onFalse otherwise. The rules of a
+ * workflow are chained through onFalse, with the last one going to the fallback
+*/
+struct RuleNode {
+  int category, sign, value;
+  int onTrue, onFalse;
 };
 
-using Workflows = unordered_map<string_view, vector<Rule>>;
-using Part = unordered_map<char, int>;
+struct Workflows {
+  vector<RuleNode> nodes;
+  int start;
+  // Number of references to each node, to know which ones are worth memoizing
+  vector<int> parents;
+};
+
+using Part = array<int, 4>;
+using Hypercube = array<pair<int, int>, 4>;
+
+constexpr int categoryIdx(char c) {
+  return (c == 'x') ? 0 : (c == 'm') ? 1 : (c == 'a') ? 2 : 3;
+}
 
+/**
+ * Parses the input, compiling the workflows into a flat array of rule nodes. Targets
+ * are resolved to the first node of the target workflow, so that a workflow that
+ * only has a fallback disappears
+*/
 pair<Workflows, vector<Part>> parseInput(const string &input) {
-  auto splits = input 
-    | splitString('\n', true);
+  auto sections = toVector(input | splitString<string_view, string>("\n\n"));
+
+  // First pass to get the first node of each workflow, its number of rules and its fallback
+  auto first = unordered_map<string_view, int>{}, ruleCount = unordered_map<string_view, int>{};
+  auto fallback = unordered_map<string_view, string_view>{};
+  int count = 0;
+  for (auto line : sections[0] | splitString('\n')) {
+    auto name = line.substr(0, line.find('{'));
+    auto last = line.find_last_of(",{") + 1;    // Workflows with only a fallback have no ','
+    first[name] = count;
+    ruleCount[name] = ranges::count(line, ':');
+    fallback[name] = line.substr(last, line.size() - last - 1);
+    count += ruleCount[name];
+  }
+  auto workflows = Workflows{vector<RuleNode>(count), 0, vector<int>(count, 0)};
+
+  // Node id of a target, skipping workflows that only have a fallback
+  auto nodeOf = [&](string_view target) {
+    for (int hops = 0; hops <= ruleCount.size(); hops++) {
+      if (target == "A") return ACCEPT;
+      if (target == "R") return REJECT;
+      if (ruleCount[target] > 0) return first[target];
+      target = fallback[target];
+    }
+    return REJECT;    // Workflows looping without rules never accept anything
+  };
+
+  for (auto line : sections[0] | splitString('\n')) {
+    auto sep = line.find('{');
+    auto name = line.substr(0, sep);
+    auto rules = toVector(line.substr(sep + 1, line.size() - sep - 2) | splitString(','));
+    int id = first[name];
+    for (int i = 0; i + 1 < rules.size(); i++, id++) {
+      auto r = rules[i];
+      auto colon = r.find(':');
+      workflows.nodes[id] = RuleNode{categoryIdx(r[0]), (r[1] == '>') ? 1 : -1, ston<int>(r.substr(2, colon - 2)),
+        nodeOf(r.substr(colon + 1)), (i + 2 < rules.size()) ? id + 1 : nodeOf(rules.back())};
+    }
+  }
+  workflows.start = nodeOf("in");
+  for (const auto &n : workflows.nodes) {
+    for (int next : {n.onTrue, n.onFalse}) {
+      if (next >= 0) workflows.parents[next]++;
+    }
+  }
 
-  // Somewhat messy but it is what it is
-  auto workflows = Workflows{};
   auto parts = vector<Part>{};
-  bool inRules = true;
-  for (auto line : splits) {
-    if (line.empty()) {
-      if (inRules) inRules = false;
-      continue;
-    }
-    if (inRules) {
-      // Parsing rules section of the input
-      auto sep = line.find('{');
-      auto name = line.substr(0, sep);
-      auto spec = line.substr(sep + 1, line.size() - sep - 2);
-      auto rules = vector<Rule>{};
-      for (auto ruleStr : spec | splitString(',')) {
-        auto sep = ruleStr.find(':');
-        if (sep != ruleStr.npos) {
-          rules.push_back(Rule{ruleStr[0], ruleStr[1], ston<int>(ruleStr.substr(2, sep - 2)), ruleStr.substr(sep + 1)});
-        } else {
-          rules.push_back(Rule{' ', ' ', 0, ruleStr});
-        }
-      }
-      workflows[name] = rules;
-    } else {
-      // Parsing parts section of the input
-      auto part = Part{};
-      for (auto p : line.substr(1, line.size() - 2) | splitString(',')) {
-        part[p[0]] = ston<int>(p.substr(2));
-      }
-      parts.push_back(part);
+  for (auto line : sections[1] | splitString('\n')) {
+    auto part = Part{};
+    for (auto p : line.substr(1, line.size() - 2) | splitString(',')) {
+      part[categoryIdx(p[0])] = ston<int>(p.substr(2));
     }
+    parts.push_back(part);
   }
   return make_pair(workflows, parts);
 }
 
-// Evaluate an operation
-inline bool eval(int lhs, char op, int rhs) {
-  switch (op) {
-    case ' ' : return true;
-    case '>' : return lhs > rhs;
-    case '<' : return lhs < rhs;
-    default : return lhs == rhs;
+/**
+ * Passes a batch of parts through the compiled workflows in lock step, one rule at
+ * a time for all of them, with the condition of each rule computed arithmetically
+ * from its sign. Parts that already finished just stay on their terminal node
+ *
+ * @param workflows Compiled workflows
+ * @param parts Parts to evaluate
+ * @return Sum of the ratings of the accepted parts
+*/
+template<int BatchSize = 16>
+int64_t acceptedRatings(const Workflows &workflows, const vector<Part> &parts) {
+  int64_t ret = 0;
+  for (size_t b = 0; b < parts.size(); b += BatchSize) {
+    int n = min<size_t>(BatchSize, parts.size() - b);
+    auto node = array<int, BatchSize>{};
+    for (int i = 0; i < BatchSize; i++) node[i] = (i < n) ? workflows.start : REJECT;
+
+    for (bool running = true; running; ) {
+      running = false;
+      for (int i = 0; i < BatchSize; i++) {
+        if (node[i] < 0) continue;
+        const auto &rule = workflows.nodes[node[i]];
+        bool cond = rule.sign * (parts[b + i][rule.category] - rule.value) > 0;
+        node[i] = cond ? rule.onTrue : rule.onFalse;
+        running |= node[i] >= 0;
+      }
+    }
+    for (int i = 0; i < n; i++) {
+      if (node[i] == ACCEPT) ret += accumulate(parts[b + i].begin(), parts[b + i].end(), 0);
+    }
   }
+  return ret;
 }
 
 Result solvePartOne(const string &input) {
   auto [workflows, parts] = parseInput(input);
+  return acceptedRatings(workflows, parts);
+}
 
-  // Pass each part through the workflow collecting the accepted ones
-  auto accepted = vector<Part>{};
-  for (const auto &part : parts) {
-    bool finished = false;
-    auto wf = workflows["in"];
-    while(!finished) {
-      for (const auto &rule : wf) {
-        // Eval rule on the part
-        if (rule.op == ' ' || eval(part.at(rule.lhs), rule.op, rule.rhs)) {
-          if (rule.next == "A") accepted.push_back(part);
-          finished = (rule.next == "A" || rule.next == "R");
-          if (!finished) wf = workflows[rule.next];
-          break;
-        }
+/**
+ * Number of accepted combinations in a hypercube ([first, second) on each category),
+ * starting on a node. Each rule node splices the hypercube in the part that follows
+ * onTrue and the part that follows onFalse. The walk uses an explicit stack so deep
+ * workflows don't overflow the call stack, and results of nodes referenced more
+ * than once are memoized by (node, hypercube)
+ *
+ * @param workflows Compiled workflows
+ * @param cube Initial hypercube
+ * @return Number of accepted combinations
+*/
+int64_t acceptedCombinations(const Workflows &workflows, const Hypercube &cube) {
+  struct Frame {
+    int node;
+    Hypercube cube;
+    int stage;
+    int64_t total;
+  };
+  auto memo = map<pair<int, Hypercube>, int64_t>{};
+  auto splice = [&workflows](const Frame &f, bool onTrue) {
+    const auto &rule = workflows.nodes[f.node];
+    auto ret = f.cube;
+    auto &[lo, hi] = ret[rule.category];
+    if (onTrue == (rule.sign > 0)) lo = max(lo, rule.value + (rule.sign > 0));
+    else hi = min(hi, rule.value + (rule.sign > 0));
+    return ret;
+  };
+
+  auto stack = vector<Frame>{{workflows.start, cube, 0, 0}};
+  int64_t ret = 0;
+  while (!stack.empty()) {
+    auto &f = stack.back();
+    if (f.stage == 0) {
+      bool empty = ranges::any_of(f.cube, [](auto l) { return l.first >= l.second; });
+      if (empty || f.node < 0) {
+        ret = (empty || f.node == REJECT) ? 0 : foldLeft(f.cube, (int64_t)1, [](auto prev, auto l) {
+          return prev * (l.second - l.first);
+        });
+        stack.pop_back();
+        continue;
       }
+      if (workflows.parents[f.node] > 1 && memo.contains({f.node, f.cube})) {
+        ret = memo[{f.node, f.cube}];
+        stack.pop_back();
+        continue;
+      }
+      f.stage = 1;
+      stack.push_back(Frame{workflows.nodes[f.node].onTrue, splice(f, true), 0, 0});
+    } else if (f.stage == 1) {
+      f.total += ret;
+      f.stage = 2;
+      stack.push_back(Frame{workflows.nodes[f.node].onFalse, splice(f, false), 0, 0});
+    } else {
+      ret = f.total + ret;
+      if (workflows.parents[f.node] > 1) memo[{f.node, f.cube}] = ret;
+      stack.pop_back();
     }
   }
-
-  return foldLeft(accepted | views::join | views::values, (int64_t)0, std::plus());
-}
-
-// Represent an hypercube
-using Hypercube = unordered_map<char, pair<int, int>>;
-
-// Splices the hypercube along the rule dimension
-pair<Hypercube, Hypercube> spliceCube(Hypercube cube, Rule rule) {
-  auto cubeInv = cube;
-  auto &limit = cube[rule.lhs], &limitInv = cubeInv[rule.lhs];
-  if (rule.op == '>') {
-    limit.first = max(limit.first, rule.rhs + 1);
-    limitInv.second = min(limitInv.second, rule.rhs + 1);
-  } else if (rule.op == '<') {
-    limit.second = min(limit.second, rule.rhs);
-    limitInv.first = max(limitInv.first, rule.rhs);
-  }
-  return make_pair(cube, cubeInv);
+  return ret;
 }
 
 Result solvePartTwo(const string &input) {
   auto [workflows, parts] = parseInput(input);
-  auto frontier = vector<pair<string_view, Hypercube>>{ { 
-  {"in", {
-    { 'x', { 1, 4001 } },
-    { 'm', { 1, 4001 } },
-    { 'a', { 1, 4001 } },
-    { 's', { 1, 4001 } },
-  } } } };
-
-  // Loop through unspliced 
-  int64_t combs = 0;
-  while (!frontier.empty()) {
-    auto [wfId, hypercube] = frontier.back();
-    frontier.pop_back();
-
-    if (wfId == "R") continue;
-    if (wfId == "A") {
-      combs += foldLeft(hypercube | views::values, (int64_t)1, [](auto prev, auto v) { return prev * (v.second - v.first); } );
-      continue;
-    }
-
-    // For each rule on the workflow, splice the hypercube, sending the first 
-    // splice (that obeys the rule) to the frontier and the other (inverted)
-    // continues checking the other rules
-    for (const auto &rule : workflows[wfId]) {
-      if (rule.op == ' ') {
-        frontier.push_back(make_pair(rule.next, hypercube));
-        break;
-      }
-
-      auto [hc1, hc2] = spliceCube(hypercube, rule);
-      frontier.push_back(make_pair(rule.next, hc1));
-      hypercube = hc2;
-    }
-  }
-
-  return combs;
+  auto cube = Hypercube{};
+  cube.fill({1, 4001});
+  return acceptedCombinations(workflows, cube);
 }
 } // namespace aoc19
@@ -2,14 +2,14 @@
 #include <iostream>
 #include <map>
 #include <numeric>
+#include <optional>
 #include <ranges>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <vector>
 #include <unordered_map>
-#include <tuple>
-#include <queue>
-#include <functional>
+#include <cstdint>
 
 #include "aoc.h"
 #include "utils.h"
@@ -19,140 +19,325 @@ namespace aoc20 {
 using namespace std;
 using namespace aoc;
 
-// Represents a gate with its state, type and inputs/outputs
-struct Gate {
-  string_view id;
-  char type;
-  bool state;
-  vector<string_view> inputIds, outputIds;
-  // For performance reasons, store references to input/output gates
-  vector<reference_wrapper<Gate>> inputGates, outputGates;
-};
+enum ModuleType : uint8_t { OTHER, FLIP_FLOP, CONJUNCTION, BROADCASTER };
 
-using Circuit = unordered_map<string_view, Gate>;
+/**
+ * Circuit compiled to dense integer ids. Modules are numbered by order of appearance,
+ * and the connections (edges) are numbered in CSR order, grouped by their source:
+ * the outputs of module m are the edges [outStart[m], outStart[m + 1]).
+ * Flip flop states are a bitset indexed by module, and the memory of conjunctions a
+ * bitset indexed by input edge, together with a counter of high inputs per module so
+ * that a conjunction's output is known without checking all its inputs. Pulses are
+ * queued as (edge << 1 | value) in a ring buffer that is reused between presses
+*/
+class Circuit {
+public:
+  Circuit(const string &input) {
+    auto lines = toVector(input | splitString('\n'));
+    auto outputNames = vector<vector<string_view>>{};
+    for (auto line : lines) {
+      auto sep = line.find(" -> ");
+      auto name = line.substr(0, sep);
+      int m = id((name[0] == '%' || name[0] == '&') ? name.substr(1) : name);
+      type[m] = (name[0] == '%') ? FLIP_FLOP : (name[0] == '&') ? CONJUNCTION : BROADCASTER;
+      outputNames.resize(names.size());
+      outputNames[m] = toVector(line.substr(sep + 4) | splitString(", "s));
+    }
+    // Modules that only appear as outputs (like rx) are sinks
+    for (int m = 0; m < outputNames.size(); m++) {
+      for (auto out : outputNames[m]) id(out);
+    }
+    outputNames.resize(names.size());
 
-// Represents a pulse
-struct Pulse {
-  Gate &sourceGate, &destGate;
-  bool value;
-};
+    int n = names.size();
+    outStart.assign(n + 1, 0);
+    inputCount.assign(n, 0);
+    for (int m = 0; m < n; m++) {
+      outStart[m + 1] = outStart[m] + outputNames[m].size();
+      for (auto out : outputNames[m]) {
+        edgeSource.push_back(m);
+        edgeTarget.push_back(ids[out]);
+        inputCount[ids[out]]++;
+      }
+    }
+    highInputs.assign(n, 0);
+    flipFlops.assign((n + 63) / 64, 0);
+    memory.assign((edgeTarget.size() + 63) / 64, 0);
+    queue.assign(bit_ceil(2 * edgeTarget.size() + 2), 0);
+    if (int b = find("broadcaster"); b != -1) {
+      for (int e = outStart[b]; e < outStart[b + 1]; e++) broadcasts.push_back(e);
+    }
+  }
+
+  int size() const { return names.size(); }
+  int find(string_view name) const { return ids.contains(name) ? ids.at(name) : -1; }
+  ModuleType moduleType(int m) const { return type[m]; }
+  int edgeCount() const { return edgeTarget.size(); }
+  int source(int e) const { return edgeSource[e]; }
+  int target(int e) const { return edgeTarget[e]; }
+  // Outputs of the broadcaster, which receive a low pulse on each push
+  const vector<int> &entries() const { return broadcasts; }
+  bool isOn(int m) const { return (flipFlops[m / 64] >> (m % 64)) & 1; }
+  bool remembersHigh(int e) const { return (memory[e / 64] >> (e % 64)) & 1; }
 
-// Creates a map of the circuit
-Circuit parseInput(const string &input) {
-  auto lines = toVector(input | splitString('\n'));
-  auto gates = Circuit{};
-
-  // Create gates and output circuit
-  for (auto line : lines) {
-    auto splits = toVector(line | splitString(" -> "s));
-    auto id = (splits[0][0] == '%' || splits[0][0] == '&') ? splits[0].substr(1) : splits[0];
-    auto outputs = toVector(splits[1] | splitString(", "s));
-    gates[id] = Gate(id, splits[0][0], false, {}, outputs);
+  /**
+   * Pushes the button, propagating the pulses until the circuit settles. Calls
+   * onPulse(source, target, value) for each pulse sent between modules (not for
+   * the one from the button to the broadcaster)
+   *
+   * @param onPulse Pulse callback
+  */
+  template<typename OnPulse>
+  void press(OnPulse onPulse) {
+    press(onPulse, broadcasts);
   }
 
-  // Fill gate inputs
-  for (const auto &[sourceId, gate] : gates) {
-    for (auto destId : gate.outputIds) {
-      if (!gates.contains(destId)) {
-        gates[destId] = Gate(destId, ' ', false, {}, {});
-      }
-      gates[destId].inputIds.push_back(sourceId);
+  /**
+   * Pushes the button with only some of the outputs of the broadcaster connected,
+   * to simulate part of the circuit in isolation
+   *
+   * @param onPulse Pulse callback
+   * @param connected Outputs of the broadcaster that receive the low pulse
+  */
+  template<typename OnPulse>
+  void press(OnPulse onPulse, const vector<int> &connected) {
+    head = tail = 0;
+    for (int e : connected) push(e, false);
+    while (head != tail) {
+      uint32_t pulse = queue[head];
+      head = (head + 1) & (queue.size() - 1);
+      int e = pulse >> 1, m = edgeTarget[e];
+      bool value = pulse & 1;
+      onPulse(edgeSource[e], m, value);
 
-      gates[sourceId].outputGates.push_back(gates[destId]);
-      gates[destId].inputGates.push_back(gates[sourceId]);
+      switch (type[m]) {
+      case FLIP_FLOP:
+        if (value) break;
+        flipFlops[m / 64] ^= uint64_t{1} << (m % 64);
+        send(m, (flipFlops[m / 64] >> (m % 64)) & 1);
+        break;
+      case CONJUNCTION:
+        if (((memory[e / 64] >> (e % 64)) & 1) != value) {
+          memory[e / 64] ^= uint64_t{1} << (e % 64);
+          highInputs[m] += value ? 1 : -1;
+        }
+        send(m, highInputs[m] != inputCount[m]);
+        break;
+      case BROADCASTER:
+        send(m, value);
+        break;
+      default:
+        break;
+      }
     }
   }
-  return gates;
-}
 
-// Processes a pulse, updating the circuit. Returns whether there was a switch
-bool processPulse(const Pulse &pulse) {
-  auto &sourceGate = pulse.sourceGate, &destGate = pulse.destGate;
-  bool switched = true;
-
-  if (destGate.type == '%') {
-    // Flip Flop, switch on down
-    switched = (sourceGate.state == false);
-    if (switched) destGate.state = !destGate.state;
-  } else if (destGate.type == '&') {
-    // NAND
-    auto initialState = true;
-    for (auto g : destGate.inputGates) {
-      initialState = initialState & g.get().state;
+private:
+  vector<string_view> names;
+  unordered_map<string_view, int> ids;
+  vector<ModuleType> type;
+  vector<int> outStart, edgeSource, edgeTarget, inputCount, highInputs, broadcasts;
+  vector<uint64_t> flipFlops, memory;
+  vector<uint32_t> queue;
+  size_t head = 0, tail = 0;
+
+  // Id of a module, registering it if new
+  int id(string_view name) {
+    auto [it, inserted] = ids.try_emplace(name, (int)names.size());
+    if (inserted) {
+      names.push_back(name);
+      type.push_back(OTHER);
     }
-    destGate.state = !initialState;
-  } else {
-    // Passthrough, not relevant
-    destGate.state = sourceGate.state;
+    return it->second;
   }
-  return switched;
-}
 
-// Runs a cycle of a button push
-// Updates the circuit with the state and returns the pulses generated
-vector<Pulse> pushTheButton(Circuit &gates) {
-  auto frontier = queue<reference_wrapper<Gate>>({ gates.at("broadcaster"sv) });
-  auto pulses = vector<Pulse>{};
-  while (!frontier.empty()) {
-    auto &sourceGate = frontier.front().get();
-    frontier.pop();
-
-    for (auto destGate : sourceGate.outputGates) {
-      auto pulse = Pulse{sourceGate, destGate, sourceGate.state};
-      pulses.push_back(pulse);
-      auto switched = processPulse(pulse);
-      if (switched) frontier.push(destGate);
+  // Queues a pulse through a connection, growing the ring buffer if full
+  void push(int e, bool value) {
+    if (((tail + 1) & (queue.size() - 1)) == head) {
+      auto grown = vector<uint32_t>(queue.size() * 2);
+      for (size_t i = 0; head != tail; i++, head = (head + 1) & (queue.size() - 1)) grown[i] = queue[head];
+      tail = queue.size() - 1;
+      head = 0;
+      queue = std::move(grown);
     }
+    queue[tail] = (e << 1) | value;
+    tail = (tail + 1) & (queue.size() - 1);
   }
-  return pulses;
-}
+
+  // Queues a pulse from a module to all its outputs
+  void send(int m, bool value) {
+    for (int e = outStart[m]; e < outStart[m + 1]; e++) push(e, value);
+  }
+};
 
 Result solvePartOne(const string &input) {
-  auto gates = parseInput(input);
+  auto circuit = Circuit(input);
 
-  // 1000 button pushes
+  // 1000 button pushes, the button pulse is always low
   int64_t low = 0, high = 0;
   for (int p = 0; p < 1000; p++) {
     low++;
-    auto pulses = pushTheButton(gates);
-    for (auto s : pulses) {
-      low += !s.value;
-      high += s.value;
-    }
+    circuit.press([&low, &high](int, int, bool value) {
+      low += !value;
+      high += value;
+    });
   }
   return low * high;
 }
 
-Result solvePartTwo(const string &input) {
-  auto gates = parseInput(input);
+// Maximum button pushes simulated on each sub-circuit when looking for its cycle
+constexpr int64_t MaxPresses = 100000;
 
-  // Test data doesn't contain RX
-  if (!gates.contains("rx")) return 0;
-
-  // By inspection of the input: RX is the result of a single NAND gate "LL"
-  // LL gets its input from 4 gates, which form 4 distinct chains from the start. 
-  // LL will be on (and RX off) only when all 4 inputs are on, so calculate the 
-  // length of the 4 loops (which is prime) and return its lcm
-  auto rxChains = unordered_map<string_view, int>{};
-  for (auto s : gates[gates["rx"].inputIds.front()].inputIds) {
-    rxChains[s] = 0;
-  }
+/**
+ * Part of the circuit that feeds one input of the conjunction before the target:
+ * all the modules from which the input can be reached, which must not receive
+ * pulses from anywhere else but the broadcaster. Its state is given by its flip
+ * flops and the memory of its conjunctions
+*/
+struct SubCircuit {
+  int output, conjunction;
+  vector<int> entries, flipFlops, memory;
+};
+
+/**
+ * Splits the circuit into independent sub-circuits, one for each input of the
+ * conjunction that feeds the target. This is possible when the target has a single
+ * input that is a conjunction, and the modules upstream of each of its inputs are
+ * disjoint and don't depend on the conjunction or the target
+ *
+ * @param circuit Circuit
+ * @param target Target module
+ * @return Sub-circuits, or nullopt if the circuit can't be split
+*/
+optional<vector<SubCircuit>> decompose(const Circuit &circuit, int target) {
+  int n = circuit.size();
+  auto inputs = vector<vector<int>>(n);
+  for (int e = 0; e < circuit.edgeCount(); e++) inputs[circuit.target(e)].push_back(e);
 
-  bool finished = false;
-  int step = 0;
-  while (!finished) {
-    auto pulses = pushTheButton(gates);
-    step++;
-    // Check if we got an on state on any of the relevant gates and store the step
-    for (auto s : pulses) {
-      if (s.value && rxChains.contains(s.sourceGate.id) && rxChains[s.sourceGate.id] == 0) {
-        rxChains[s.sourceGate.id] = step;
+  if (inputs[target].size() != 1) return nullopt;
+  int conjunction = circuit.source(inputs[target][0]);
+  if (circuit.moduleType(conjunction) != CONJUNCTION) return nullopt;
+
+  auto ret = vector<SubCircuit>{};
+  auto owner = vector<int>(n, -1);
+  for (int e : inputs[conjunction]) {
+    int output = circuit.source(e), id = ret.size();
+    if (owner[output] != -1 || circuit.moduleType(output) == BROADCASTER) return nullopt;
+    auto sub = SubCircuit{output, conjunction, {}, {}, {}};
+    auto pending = vector<int>{output};
+    owner[output] = id;
+    while (!pending.empty()) {
+      int m = pending.back();
+      pending.pop_back();
+      if (circuit.moduleType(m) == FLIP_FLOP) sub.flipFlops.push_back(m);
+      for (int in : inputs[m]) {
+        int source = circuit.source(in);
+        if (circuit.moduleType(m) == CONJUNCTION) sub.memory.push_back(in);
+        if (circuit.moduleType(source) == BROADCASTER) {
+          sub.entries.push_back(in);
+        } else if (source == conjunction || source == target || (owner[source] != -1 && owner[source] != id)) {
+          return nullopt;
+        } else if (owner[source] == -1) {
+          owner[source] = id;
+          pending.push_back(source);
+        }
       }
     }
-    finished = all_of(rxChains.begin(), rxChains.end(), [](auto v) { return v.second != 0; });
+    ranges::sort(sub.entries);
+    ret.push_back(sub);
+  }
+  return ret;
+}
+
+/**
+ * Simulates a sub-circuit in isolation until its state repeats, to get the pushes
+ * where its output is high for the conjunction (either remembered from before or
+ * sent during the push). Assumes, as happens on the inputs, that outputs high on
+ * the same push are high at the same time
+ *
+ * @param circuit Circuit, simulated on a copy
+ * @param sub Sub-circuit
+ * @param maxPresses Maximum pushes to simulate
+ * @return Pushes where the output is high, or nullopt if the state doesn't repeat
+*/
+optional<PeriodicEvents> findCycle(Circuit circuit, const SubCircuit &sub, int64_t maxPresses) {
+  int outputEdge = -1;
+  for (int e = 0; e < circuit.edgeCount(); e++) {
+    if (circuit.source(e) == sub.output && circuit.target(e) == sub.conjunction) outputEdge = e;
+  }
+  auto state = [&circuit, &sub]() {
+    auto ret = vector<uint64_t>((sub.flipFlops.size() + sub.memory.size() + 63) / 64);
+    size_t bit = 0;
+    for (int m : sub.flipFlops) ret[bit / 64] |= uint64_t{circuit.isOn(m)} << (bit % 64), bit++;
+    for (int e : sub.memory) ret[bit / 64] |= uint64_t{circuit.remembersHigh(e)} << (bit % 64), bit++;
+    return ret;
+  };
+
+  auto seen = map<vector<uint64_t>, int64_t>{{state(), 0}};
+  auto high = vector<int64_t>{};
+  for (int64_t p = 1; p <= maxPresses; p++) {
+    bool isHigh = circuit.remembersHigh(outputEdge);
+    circuit.press([&isHigh, &sub](int source, int target, bool value) {
+      isHigh |= value && source == sub.output && target == sub.conjunction;
+    }, sub.entries);
+    if (isHigh) high.push_back(p);
+
+    // State after push p is the same as after push `first`, so pushes after `first` repeat
+    auto [it, inserted] = seen.try_emplace(state(), p);
+    if (inserted) continue;
+    auto ret = PeriodicEvents{it->second + 1, p - it->second, {}, {}};
+    for (auto t : high) {
+      if (t < ret.offset) ret.before.push_back(t);
+      else ret.residues.push_back(t % ret.period);
+    }
+    ranges::sort(ret.residues);
+    return ret;
   }
+  return nullopt;
+}
+
+/**
+ * First push that sends a low pulse to the target. If the circuit splits into
+ * independent sub-circuits feeding the conjunction before the target, the cycle of
+ * each one is found (each on its own thread) and the pushes where all their outputs
+ * are high are combined. Circuits that don't have that structure aren't solved (no
+ * brute force fallback), and neither are sub-circuits that don't repeat in
+ * maxPresses pushes
+ *
+ * @param circuit Circuit
+ * @param target Target module
+ * @param maxPresses Maximum pushes to simulate on each sub-circuit
+ * @return First push with a low pulse to the target, or nullopt if the circuit doesn't
+ * split or a sub-circuit doesn't repeat
+*/
+optional<int64_t> firstLowPulse(const Circuit &circuit, int target, int64_t maxPresses) {
+  auto subs = decompose(circuit, target);
+  if (!subs) return nullopt;
+
+  auto cycles = vector<optional<PeriodicEvents>>(subs->size());
+  {
+    auto threads = vector<jthread>{};
+    for (size_t i = 0; i < subs->size(); i++) {
+      threads.emplace_back([&circuit, &subs, &cycles, i, maxPresses]() {
+        cycles[i] = findCycle(circuit, (*subs)[i], maxPresses);
+      });
+    }
+  }
+  if (!ranges::all_of(cycles, [](const auto &c) { return c.has_value(); })) return nullopt;
+  return firstCommonEvent(toVector(cycles | views::transform([](const auto &c) { return *c; })));
+}
+
+Result solvePartTwo(const string &input) {
+  auto circuit = Circuit(input);
+
+  // Test data doesn't contain RX
+  int rx = circuit.find("rx");
+  if (rx == -1) return 0;
 
-  // LCM of length
-  return foldLeft(rxChains | views::values, (int64_t)1, lcm<int64_t, int64_t>);
+  auto presses = firstLowPulse(circuit, rx, MaxPresses);
+  if (presses)
+    return *presses;
+  else
+    return monostate();
 }
 } // namespace aoc20
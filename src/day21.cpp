@@ -1,14 +1,17 @@
 #include <algorithm>
+#include <array>
+#include <bit>
+#include <climits>
 #include <iostream>
 #include <map>
 #include <numeric>
+#include <optional>
 #include <ranges>
 #include <string>
 #include <string_view>
 #include <vector>
-#include <unordered_set>
-#include <unordered_map>
-#include <deque>
+#include <utility>
+#include <cstdint>
 
 #include "aoc.h"
 #include "utils.h"
@@ -18,82 +21,249 @@ namespace aoc21 {
 using namespace std;
 using namespace aoc;
 
-using Pos = vec2<int>;
-using Dir = vec2<int>;
-
-// Standard directions
-constexpr auto 
-  NORTH = Dir(0, -1),
-  SOUTH = Dir(0, 1),
-  EAST = Dir(1, 0),
-  WEST = Dir(-1, 0);
-
-constexpr char START = 'S', ROCK = '#', EMPTY = '.';
-
-// Returns the active nodes on the grid, with max steps limit
-auto countActive(const vector<string_view> &grid, int maxSteps, bool infiniteBoard) {
-  auto h = (int)grid.size(), w = (int)grid[0].size();  
-  auto startPos = Pos{h / 2, w / 2};
-  const auto dirs = vector{EAST, WEST, SOUTH, NORTH};
-  auto frontier = deque<pair<Pos, int>>{ {startPos, 0 }};
-  auto vh = 2 * (maxSteps + 1), vw = 2 * (maxSteps + 1);
-  auto cy = (vh - h) / 2, cx = (vw - w) / 2;
-  auto visited = vector(vh, vector(vw, -1));
-  visited[cy + startPos.y][cx + startPos.x] = 0;
-
-  auto active = int64_t{ maxSteps % 2 == 0 };
-  while (!frontier.empty()) {
-    auto [p, step] = frontier.front();
-    frontier.pop_front();
-    if (++step > maxSteps) break;
-
-    for (const auto &d : dirs) {
-      auto nextP = p + d;
-      auto x = nextP.x % w, y = nextP.y % h;
-      if (x < 0) x += w;
-      if (y < 0) y += h;
-      if ((infiniteBoard || insideBoard(grid, nextP)) && 
-          (grid[y][x] != ROCK) && 
-          (visited[cy + nextP.y][cx + nextP.x] == -1)) {
-        visited[cy + nextP.y][cx + nextP.x] = step;
-        active += ((step % 2) == (maxSteps % 2));
-        frontier.push_back(make_pair(nextP, step));
+using int128 = __int128;
+
+constexpr char START = 'S', ROCK = '#';
+
+/**
+ * Garden repeated on (2 * radius + 1) x (2 * radius + 1) tiles, with the start on
+ * the center tile, and the plots reached after each step as a bitset. As a plot
+ * reachable in n steps is also reachable in n + 2 steps (going back and forth),
+ * the plots reached after the next step are just the neighbours of the current ones
+ * that aren't rocks, which is computed a word at a time with shifts. Only the words
+ * that the steps so far can reach are updated
+*/
+class GardenStepper {
+public:
+  GardenStepper(const vector<string_view> &grid, int radius) :
+      w{(int)grid[0].size()}, h{(int)grid.size()}, radius{radius}, tiles{2 * radius + 1},
+      plots(w * tiles, h * tiles), reached(w * tiles, h * tiles), next(w * tiles, h * tiles) {
+    for (int y = 0; y < plots.height; y++) {
+      for (int x = 0; x < plots.width; x++) {
+        char c = grid[y % h][x % w];
+        plots.set(x, y, c != ROCK);
+        if (c == START && x / w == radius && y / h == radius) {
+          startX = x;
+          startY = y;
+        }
       }
     }
+    reached.set(startX, startY);
+  }
+
+  int steps() const { return stepCount; }
+
+  void step() {
+    int wpl = plots.wordsPerLine;
+    int y0 = max(0, startY - stepCount - 1), y1 = min(plots.height - 1, startY + stepCount + 1);
+    int w0 = max(0, startX - stepCount - 1) / 64, w1 = min(plots.width - 1, startX + stepCount + 1) / 64;
+    for (int y = y0; y <= y1; y++) {
+      const auto *cur = reached.line(y), *mask = plots.line(y);
+      const auto *up = (y > 0) ? reached.line(y - 1) : nullptr, *down = (y + 1 < plots.height) ? reached.line(y + 1) : nullptr;
+      auto *out = next.line(y);
+      for (int i = w0; i <= w1; i++) {
+        uint64_t left = (cur[i] << 1) | ((i > 0) ? cur[i - 1] >> 63 : 0);
+        uint64_t right = (cur[i] >> 1) | ((i + 1 < wpl) ? cur[i + 1] << 63 : 0);
+        out[i] = (left | right | (up ? up[i] : 0) | (down ? down[i] : 0)) & mask[i];
+      }
+    }
+    swap(reached, next);
+    stepCount++;
+  }
+
+  // Plots reached on the tile copy (tx, ty), relative to the center tile
+  int64_t count(int tx, int ty) const {
+    int64_t ret = 0;
+    int x0 = (tx + radius) * w, y0 = (ty + radius) * h;
+    for (int y = y0; y < y0 + h; y++) ret += reached.count(y, x0, x0 + w);
+    return ret;
+  }
+
+  // Plots reached on all tiles
+  int64_t count() const {
+    return foldLeft(reached.words, (int64_t)0, [](auto prev, auto word) { return prev + popcount(word); });
   }
-  return active;
-}
+
+private:
+  int w, h, radius, tiles, startX = 0, startY = 0, stepCount = 0;
+  BitGrid plots, reached, next;
+};
 
 Result solvePartOne(const string &input) {
   auto grid = toVector(input | splitString<string_view>('\n'));
-  return countActive(grid, 64, false);
+  auto garden = GardenStepper(grid, 0);
+  while (garden.steps() < 64) garden.step();
+  return garden.count();
 }
 
-// Lagrange interpolation polynomial
-auto lagrangePoly(const vector<int64_t> &xs, const vector<int64_t> &ys) {
-  return [&xs, &ys](int64_t x) {
-    auto n = xs.size();
-    auto sum = int64_t{ 0 };
-    for (int j = 0; j < n; j++) {
-      auto prod = int64_t{ 1 };
-      for (int i = 0; i < n; i++) {
-        if (i == j) continue;
-        prod *= (x - xs[i])/(xs[j] - xs[i]);
+// Plots reached on each tile copy with |tx|, |ty| <= radius, indexed by (ty + radius) * (2 * radius + 1) + tx + radius
+using TileCounts = vector<int64_t>;
+
+/**
+ * Plots reached after n steps on an infinite garden, extrapolated from the tile
+ * counts after n0 = n - (K - k0) * w steps, where K is the tile distance of the
+ * frontier at n steps, and k0 the one at n0. Tiles far enough behind the frontier
+ * saturate, alternating between the two parity states (full[0] and full[1]). The
+ * tiles near the frontier depend only on their distance to it and on their axis or
+ * quadrant, so the ones at n steps are the ones at n0, with the tiles on each
+ * quadrant diagonal repeated (d - 1) times at tile distance d
+ *
+ * @param counts Tile counts after n0 steps
+ * @param radius Tile radius of counts
+ * @param full Plots reached on a saturated tile, by the parity of the steps relative to it
+ * @param w Width of the garden
+ * @param k0 Tile distance of the frontier after n0 steps
+ * @param n Steps
+ * @param K Tile distance of the frontier after n steps
+ * @return Plots reached after n steps, or nullopt if the tiles on a quadrant diagonal differ
+*/
+optional<int64_t> extrapolate(const TileCounts &counts, int radius, const array<int64_t, 2> &full,
+    int64_t w, int64_t k0, int64_t n, int64_t K) {
+  int tiles = 2 * radius + 1;
+  auto tile = [&counts, radius, tiles](int tx, int ty) { return counts[(ty + radius) * tiles + tx + radius]; };
+
+  // Saturated tiles, at sim distance d0 <= 1
+  int64_t ret = 0;
+  for (int64_t d = 0; d - (K - k0) <= 1; d++) ret += ((d == 0) ? 1 : 4 * d) * full[(n + d * w) % 2];
+
+  for (int d0 = 2; d0 <= 2 * radius; d0++) {
+    int64_t d = d0 + K - k0;
+    for (auto [sx, sy] : { pair{1, 1}, pair{1, -1}, pair{-1, 1}, pair{-1, -1} }) {
+      // Axis tile, and quadrant diagonal (which must have all tiles equal)
+      if (d0 <= radius) ret += (sy == 1) ? tile(sx * d0, 0) : tile(0, sx * d0);
+      int64_t diagonal = -1;
+      for (int i = 1; i < d0; i++) {
+        if (i > radius || d0 - i > radius) continue;
+        auto c = tile(sx * i, sy * (d0 - i));
+        if (diagonal != -1 && c != diagonal) return nullopt;
+        diagonal = c;
       }
-      sum += ys[j] * prod;
+      if (diagonal != -1) ret += diagonal * (d - 1);
     }
-    return sum;
+  }
+  return ret;
+}
+
+/**
+ * Plots reached after n steps on an infinite garden, simulating only a few tiles
+ * around the start and extrapolating with the saturated and frontier tiles. This
+ * needs the frontier to spread evenly through the tiles, as happens with the free
+ * lanes from the start to the edges on the inputs, so the extrapolation is checked
+ * against the simulation one tile further
+ *
+ * @param grid Garden
+ * @param n Steps
+ * @return Plots reached, or nullopt if the garden doesn't extrapolate
+*/
+optional<int64_t> reachedPlots(const vector<string_view> &grid, int64_t n) {
+  constexpr int64_t k0 = 3;
+  int64_t w = grid[0].size(), h = grid.size();
+  if (w != h) return nullopt;
+  int64_t K = max<int64_t>(0, (n - w / 2) / w), n0 = n - (K - k0) * w;
+
+  // The simulation goes up to n0 + w steps, with the frontier at tile distance k0 + 2
+  int radius = k0 + 2;
+  auto garden = GardenStepper(grid, radius);
+  auto snapshot = [&garden, radius]() {
+    auto ret = TileCounts{};
+    for (int ty = -radius; ty <= radius; ty++) {
+      for (int tx = -radius; tx <= radius; tx++) ret.push_back(garden.count(tx, ty));
+    }
+    return ret;
   };
+  if (K <= k0 + 1) {
+    while (garden.steps() < n) garden.step();
+    return garden.count();
+  }
+
+  auto counts = TileCounts{};
+  auto full = array<int64_t, 2>{};
+  int64_t atN0 = 0;
+  while (garden.steps() < n0 + w) {
+    garden.step();
+    if (garden.steps() == n0) {
+      counts = snapshot();
+      atN0 = garden.count();
+      full[n0 % 2] = garden.count(0, 0);
+    } else if (garden.steps() == n0 + 1) {
+      full[(n0 + 1) % 2] = garden.count(0, 0);
+    }
+  }
+
+  if (extrapolate(counts, radius, full, w, k0, n0, k0) != atN0 ||
+      extrapolate(counts, radius, full, w, k0, n0 + w, k0 + 1) != garden.count()) return nullopt;
+  return extrapolate(counts, radius, full, w, k0, n, K);
 }
 
+/**
+ * Plots reached after each number of steps up to a limit, on an infinite garden
+ *
+ * @param grid Garden
+ * @param maxSteps Limit of steps
+ * @return Plots reached after 0 to maxSteps steps
+*/
+vector<int64_t> countSteps(const vector<string_view> &grid, int64_t maxSteps) {
+  auto garden = GardenStepper(grid, maxSteps / grid.size() + 1);
+  auto ret = vector<int64_t>{garden.count()};
+  while (garden.steps() < maxSteps) {
+    garden.step();
+    ret.push_back(garden.count());
+  }
+  return ret;
+}
+
+/**
+ * Exact extrapolation of the plots reached after any number of steps, from the
+ * counts of all steps up to a limit. Sampled once per period (the tile width), the
+ * counts on each class of steps modulo the period are assumed to follow a quadratic,
+ * which is fitted on the last samples of the class with Newton forward differences
+ * and checked on one more sample. It's evaluated in 128 bits, where the only
+ * division is the exact k * (k - 1) / 2, so many targets can be answered from the
+ * same counts
+*/
+class QuadraticExtrapolation {
+public:
+  QuadraticExtrapolation(vector<int64_t> counts, int64_t period) : counts{std::move(counts)}, period{period} {}
+
+  optional<int64_t> operator()(int64_t steps) const {
+    int64_t last = counts.size() - 1;
+    if (steps <= last) return counts[steps];
+
+    // Base of the 4 samples, on the same class as steps, with the last sample as far as possible
+    int64_t limit = last - 3 * period;
+    int64_t base = limit - ((limit - steps) % period + period) % period;
+    if (base < 0) return nullopt;
+    auto y = array<int128, 4>{};
+    for (int i = 0; i < 4; i++) y[i] = counts[base + i * period];
+    int128 d1 = y[1] - y[0], d2 = y[2] - 2 * y[1] + y[0], d3 = y[3] - 3 * y[2] + 3 * y[1] - y[0];
+    if (d3 != 0) return nullopt;
+
+    // f(k) = y0 + k * d1 + k * (k - 1) / 2 * d2
+    int128 k = (steps - base) / period, linear, quadratic, ret;
+    bool overflow = __builtin_mul_overflow(k, d1, &linear);
+    overflow |= __builtin_mul_overflow(k * (k - 1) / 2, d2, &quadratic);
+    overflow |= __builtin_add_overflow(y[0] + linear, quadratic, &ret);
+    if (overflow || ret < 0 || ret > INT64_MAX) return nullopt;
+    return (int64_t)ret;
+  }
+
+private:
+  vector<int64_t> counts;
+  int64_t period;
+};
+
 Result solvePartTwo(const string &input) {
   auto grid = toVector(input | splitString<string_view>('\n'));
-  auto h = (int)grid.size(), halfH = h / 2;
-  auto xs = vector<int64_t>{h/2, h/2 + h, h/2 + 2*h},
-       ys = toVector(xs | views::transform([&grid](auto x) { return countActive(grid, x, true); }));
-  
-  return lagrangePoly(xs, ys)(26501365);
+  constexpr int64_t steps = 26501365;
+  if (auto plots = reachedPlots(grid, steps)) return *plots;
 
+  // Otherwise extrapolate from the counts up to 6 tiles away
+  auto w = (int64_t)grid[0].size();
+  auto plots = QuadraticExtrapolation(countSteps(grid, w / 2 + 6 * w), w)(steps);
+  if (plots)
+    return *plots;
+  else
+    return monostate();
 }
 
 } // namespace aoc21
@@ -1,12 +1,15 @@
 #include <algorithm>
+#include <array>
+#include <bit>
 #include <iostream>
 #include <map>
 #include <numeric>
 #include <ranges>
+#include <span>
 #include <string>
 #include <string_view>
 #include <vector>
-#include <queue>
+#include <cstdint>
 
 #include "aoc.h"
 #include "utils.h"
@@ -16,106 +19,154 @@ namespace aoc22 {
 using namespace std;
 using namespace aoc;
 
+// Brick as its lowest and highest corners
 using Brick = pair<vec3<int>, vec3<int>>;
 
-vector<Brick> parseInput(const string &input) {
-  return toVector(input 
-    | splitString('\n') 
-    | views::transform([](string_view line) { 
-      auto v = toVector(line 
-        | splitString('~')
-        | views::transform([](string_view end) {
-          auto v = toVector(end | splitNumbers(','));
-          return vec3<int>(v[0], v[1], v[2]);
-        }));
-      auto v1 = vec3<int>(min(v[0].x, v[1].x), min(v[0].y, v[1].y), min(v[0].z, v[1].z));
-      auto v2 = vec3<int>(max(v[0].x, v[1].x), max(v[0].y, v[1].y), max(v[0].z, v[1].z));
-      return make_pair(v1, v2);
-     }));
-}
+/**
+ * Settled pile of bricks, numbered bottom up in settling order. The supporters of
+ * each brick are stored as CSR arrays: the supporters of brick i are bellow[j] for
+ * j in [bellowStart[i], bellowStart[i + 1])
+*/
+struct Pile {
+  vector<int> bellowStart, bellow;
 
-auto settleDown(vector<Brick> &bricks) {
-  auto wellsz = 1 + foldLeft(bricks, 0, [](int prev, auto &b) { return max(prev, max(b.second.x, b.second.y)); });
-  auto well = vector(wellsz, vector<pair<int, int>>(wellsz, {0, -1}));
-  auto supportsBellow = vector(bricks.size(), vector<int>{});
-  for (int i = 0; i < bricks.size(); i++) {
-    auto maxHeight = 0;
-    for (int y = bricks[i].first.y; y <= bricks[i].second.y; y++) {
-      for (int x = bricks[i].first.x; x <= bricks[i].second.x; x++) {
-        auto [height, supporterId] = well[y][x];
-        if (height < maxHeight) continue;
+  int size() const { return bellowStart.size() - 1; }
+  span<const int> supportsBellow(int i) const { return span(bellow).subspan(bellowStart[i], bellowStart[i + 1] - bellowStart[i]); }
+};
 
-        if (height > maxHeight) {
-          maxHeight = height;
-          supportsBellow[i].clear();
-        } 
-        if (supporterId != -1 && (ranges::find(supportsBellow[i], supporterId) == supportsBellow[i].end())) {
-          supportsBellow[i].push_back(supporterId);
-        }
+// Parses the 6 numbers of each line, ordering the corners of each brick
+vector<Brick> parseInput(const string &input) {
+  auto bricks = vector<Brick>{};
+  auto v = array<int, 6>{};
+  int idx = 0, num = 0;
+  bool inNumber = false;
+  for (size_t p = 0; p <= input.size(); p++) {
+    char c = (p < input.size()) ? input[p] : '\n';
+    if (c >= '0' && c <= '9') {
+      num = num * 10 + (c - '0');
+      inNumber = true;
+    } else if (inNumber) {
+      v[idx++] = num;
+      num = 0;
+      inNumber = false;
+      if (idx == 6) {
+        bricks.push_back({vec3<int>(min(v[0], v[3]), min(v[1], v[4]), min(v[2], v[5])),
+          vec3<int>(max(v[0], v[3]), max(v[1], v[4]), max(v[2], v[5]))});
+        idx = 0;
       }
     }
+  }
+  return bricks;
+}
 
-    auto brickHeight = bricks[i].second.z - bricks[i].first.z;
-    auto wellFill = make_pair(maxHeight + 1 + brickHeight, i);
-    for (int y = bricks[i].first.y; y <= bricks[i].second.y; y++) {
-      for (int x = bricks[i].first.x; x <= bricks[i].second.x; x++) {
-        well[y][x] = wellFill;
-      }
-    }
-    bricks[i].first.z = maxHeight + 1; 
-    bricks[i].second.z = maxHeight + 1 + brickHeight;
+/**
+ * Settles the bricks, bottom up, on a flat height map that also keeps the brick on
+ * top of each column. Bricks are ordered by their lowest z with a counting sort, as
+ * coordinates are small. The supporters of a brick are the distinct bricks on top
+ * of the highest columns under it, deduplicated with a stamp of the last brick they
+ * were added to
+ *
+ * @param input Input
+ * @return Settled pile
+*/
+Pile settle(const string &input) {
+  auto unsorted = parseInput(input);
+  int n = unsorted.size(), maxZ = 0, w = 1, d = 1;
+  for (const auto &[lo, hi] : unsorted) {
+    maxZ = max(maxZ, lo.z);
+    w = max(w, hi.x + 1);
+    d = max(d, hi.y + 1);
   }
-  auto supportsAbove = vector(bricks.size(), vector<int>{});
-  for (int i = 0; i < bricks.size(); i++) {
-    for (int j : supportsBellow[i]) {
-      supportsAbove[j].push_back(i);
+  auto start = vector<int>(maxZ + 2, 0);
+  for (const auto &b : unsorted) start[b.first.z + 1]++;
+  partial_sum(start.begin(), start.end(), start.begin());
+  auto bricks = vector<Brick>(n);
+  for (const auto &b : unsorted) bricks[start[b.first.z]++] = b;
+
+  auto pile = Pile{vector<int>(n + 1, 0), {}};
+  auto height = vector<int>(w * d, 0), top = vector<int>(w * d, -1), stamp = vector<int>(n, -1);
+  for (int i = 0; i < n; i++) {
+    const auto &[lo, hi] = bricks[i];
+    int maxHeight = 0;
+    for (int y = lo.y; y <= hi.y; y++) {
+      for (int x = lo.x; x <= hi.x; x++) maxHeight = max(maxHeight, height[y * w + x]);
     }
+    for (int y = lo.y; y <= hi.y; y++) {
+      for (int x = lo.x; x <= hi.x; x++) {
+        int t = top[y * w + x];
+        if (height[y * w + x] == maxHeight && t != -1 && stamp[t] != i) {
+          stamp[t] = i;
+          pile.bellow.push_back(t);
+        }
+        height[y * w + x] = maxHeight + 1 + hi.z - lo.z;
+        top[y * w + x] = i;
+      }
+    }
+    pile.bellowStart[i + 1] = pile.bellow.size();
   }
-  return make_pair(supportsBellow, supportsAbove);
+  return pile;
 }
 
 Result solvePartOne(const string &input) {
-  auto bricks = parseInput(input);
-  sort(bricks.begin(), bricks.end(), [](const auto &b1, const auto &b2) {
-    return min(b1.first.z, b1.second.z) < min(b2.first.z, b2.second.z);
-  });
-  auto [supportsBellow, supportsAbove] = settleDown(bricks);
+  auto pile = settle(input);
 
   // Mark bricks that singly support another
-  auto singleSupporters = vector<bool>(bricks.size(), false);
-  for (auto s : supportsBellow) {
+  auto singleSupporters = vector<bool>(pile.size(), false);
+  for (int i = 0; i < pile.size(); i++) {
+    auto s = pile.supportsBellow(i);
     if (s.size() == 1) singleSupporters[s.front()] = true;
   }
   return ranges::count(singleSupporters, false);
 }
 
-Result solvePartTwo(const string &input) {
-  auto bricks = parseInput(input);
-  sort(bricks.begin(), bricks.end(), [](const auto &b1, const auto &b2) {
-    return min(b1.first.z, b1.second.z) < min(b2.first.z, b2.second.z);
-  });
-  auto [supportsBellow, supportsAbove] = settleDown(bricks);
-
-  // Mark each brick as fallen and process a queue of fallen bricks. Mark bricks 
-  // supported by them ones as fallen if all of their supports have fallen
-  auto count = 0;
-  auto fallen = vector<int>(bricks.size());
-  for (int i = 0; i < bricks.size(); i++) {
-    ranges::fill(fallen, 0);
-    fallen[i] = 1;
-    auto q = queue<int>({i});
-    while (!q.empty()) {
-      auto curr = q.front();
-      q.pop();
-      for (auto supported : supportsAbove[curr]) {
-        if (ranges::all_of(supportsBellow[supported], [&fallen](auto s) { return fallen[s] == 1; })) {
-          fallen[supported] = 1;
-          q.push(supported);
-        }
+/**
+ * Number of bricks that fall when each brick is disintegrated. A brick falls when
+ * all paths from the ground to it go through the disintegrated one, so the bricks
+ * that fall are the subtree of the disintegrated brick on the dominator tree of the
+ * support graph, rooted on the ground. Bricks are settled bottom up, so supporters
+ * come before the bricks they support, and the immediate dominator of a brick is
+ * the lowest common ancestor of its supporters (found with binary lifting), or the
+ * ground if it rests on it. Subtree sizes are then accumulated top down
+ *
+ * @param pile Settled pile
+ * @return Number of other bricks that fall for each brick
+*/
+vector<int> chainReactions(const Pile &pile) {
+  // Node 0 is the ground, and brick i is node i + 1
+  int n = pile.size() + 1, levels = bit_width((unsigned)n);
+  auto up = vector<int>((size_t)levels * n, 0), depth = vector<int>(n, 0);
+  auto ancestor = [&up, n](int level, int v) -> int & { return up[(size_t)level * n + v]; };
+  auto lca = [&](int a, int b) {
+    if (depth[a] < depth[b]) swap(a, b);
+    for (int l = levels - 1; l >= 0; l--) {
+      if (depth[a] - (1 << l) >= depth[b]) a = ancestor(l, a);
+    }
+    if (a == b) return a;
+    for (int l = levels - 1; l >= 0; l--) {
+      if (ancestor(l, a) != ancestor(l, b)) {
+        a = ancestor(l, a);
+        b = ancestor(l, b);
       }
     }
-    count += accumulate(fallen.begin() + i + 1, fallen.end(), 0);
+    return ancestor(0, a);
+  };
+
+  for (int v = 1; v < n; v++) {
+    auto supporters = pile.supportsBellow(v - 1);
+    int dominator = supporters.empty() ? 0 : supporters.front() + 1;
+    for (int s : supporters) dominator = lca(dominator, s + 1);
+    depth[v] = depth[dominator] + 1;
+    ancestor(0, v) = dominator;
+    for (int l = 1; l < levels; l++) ancestor(l, v) = ancestor(l - 1, ancestor(l - 1, v));
   }
-  return count;
+
+  auto subtree = vector<int>(n, 1);
+  for (int v = n - 1; v > 0; v--) subtree[ancestor(0, v)] += subtree[v];
+  return toVector(subtree | views::drop(1) | views::transform([](int size) { return size - 1; }));
+}
+
+Result solvePartTwo(const string &input) {
+  auto fallen = chainReactions(settle(input));
+  return accumulate(fallen.begin(), fallen.end(), (int64_t)0);
 }
 } // namespace aoc22
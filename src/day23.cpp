@@ -1,15 +1,17 @@
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
 #include <iostream>
 #include <map>
 #include <numeric>
 #include <ranges>
+#include <span>
 #include <string>
 #include <string_view>
 #include <vector>
 #include <unordered_map>
-#include <unordered_set>
-#include <deque>
-#include <format>
+#include <cstdint>
 
 #include "aoc.h"
 #include "utils.h"
@@ -19,155 +21,322 @@ namespace aoc23 {
 using namespace std;
 using namespace aoc;
 
-constexpr char WALL = '#', EMPTY = '.';
+constexpr char WALL = '#';
 
-using Pos = vec2<int>;
-using Dir = vec2<int>;
-using PosHash = vec2Hash<int>;
+// Weighted graph in CSR form: the edges (node, steps) leaving node v are edges[j] for j in [first[v], first[v + 1])
+struct Graph {
+  vector<int> first;
+  vector<pair<int, int>> edges;
 
-constexpr auto NORTH = Dir(0, -1), SOUTH = Dir(0, 1), EAST = Dir(1, 0), WEST = Dir(-1, 0);
+  int size() const { return first.size() - 1; }
+  span<const pair<int, int>> operator[](int v) const {
+    return span(edges).subspan(first[v], first[v + 1] - first[v]);
+  }
+};
+
+// Builds a graph from a list of edges (from, to, steps)
+Graph makeGraph(int n, const vector<array<int, 3>> &edges) {
+  auto ret = Graph{vector<int>(n + 1, 0), vector<pair<int, int>>(edges.size())};
+  for (const auto &e : edges) ret.first[e[0] + 1]++;
+  partial_sum(ret.first.begin(), ret.first.end(), ret.first.begin());
+  auto pos = vector<int>(ret.first.begin(), ret.first.end() - 1);
+  for (const auto &e : edges) ret.edges[pos[e[0]]++] = {e[1], e[2]};
+  return ret;
+}
+
+// Junction graphs of the maze: ignoring the slopes, and following them
+struct Maze {
+  int start, goal;
+  Graph undirected, directed;
+};
 
-// Transforms the grid to a graph representation
-auto gridToGraph(const vector<string> &grid, Pos startPos, Pos goalPos) {
-  const auto dirs = vector{EAST, WEST, SOUTH, NORTH};
-  const auto forbidden = unordered_map<char, Pos>{ { '>', WEST }, { '<', EAST }, { 'v', NORTH }, { '^', SOUTH } };
-  auto validPos = [&forbidden](const vector<string> &grid, Pos pos, Dir dir) {
-    return insideBoard(grid, pos) &&
-      ((grid[pos.y][pos.x] == EMPTY) ||
-      (forbidden.contains(grid[pos.y][pos.x]) && (dir != forbidden.at(grid[pos.y][pos.x]))));
+/**
+ * Compresses the maze into the graph of its junctions (the cells with 3 or more open
+ * neighbours, plus the start and the goal), with edges weighted by the length of the
+ * corridors between them. The grid is padded with walls so neighbours never need
+ * bounds checks, and each corridor is walked once, from the first junction that
+ * reaches it, following the only open neighbour on the mask of each cell besides
+ * the one it came from. Both graphs are emitted from the same walk, the directed one
+ * only having the directions where every slope on the corridor is followed downhill
+ *
+ * @param input Input
+ * @return Junction graphs
+*/
+Maze compress(const string &input) {
+  int w = input.find('\n'), h = (input.size() + 1) / (w + 1), pw = w + 2;
+  auto cells = string((size_t)pw * (h + 2), WALL);
+  for (int y = 0; y < h; y++) copy_n(input.begin() + y * (w + 1), w, cells.begin() + (y + 1) * pw + 1);
+  const int offsets[] = { -pw, 1, pw, -1 };      // North, east, south, west
+  auto slopeDir = [](char c) { return (c == '^') ? 0 : (c == '>') ? 1 : (c == 'v') ? 2 : (c == '<') ? 3 : -1; };
+  auto openMask = [&cells, &offsets](int c) {
+    int ret = 0;
+    for (int d = 0; d < 4; d++) ret |= (cells[c + offsets[d]] != WALL) << d;
+    return ret;
   };
 
-  // Returns the junctions reachable from a given position on the grid
-  auto successors = [&grid, &dirs, &validPos](const Pos &origin) {
-    auto succ = vector<pair<Pos, int>>{};
-    // Follow maze for each direction, starting on origin, until a junction found
-    for (auto pathDir : dirs) {
-      auto pos = origin + pathDir;
-      if (!validPos(grid, pos, pathDir)) continue;
-      for (int steps = 1;;steps++) {
-        auto possibleDirs = toVector(dirs 
-          | views::filter([&grid, &validPos, &pos, &pathDir](Dir d) {
-              return (d != -pathDir) && validPos(grid, pos + d, d);
-            }));
-        if (possibleDirs.size() != 1) {   // Junction found
-          succ.push_back(make_pair(pos, steps));
-          break;
-        }
-        pathDir = possibleDirs.front();
-        pos += pathDir;
+  int startCell = cells.find('.'), goalCell = cells.rfind('.');
+  auto junction = vector<int>(cells.size(), -1);
+  int n = 0;
+  for (int c = pw; c < (int)cells.size() - pw; c++) {
+    if (cells[c] != WALL && (popcount((unsigned)openMask(c)) >= 3 || c == startCell || c == goalCell)) junction[c] = n++;
+  }
+
+  auto undirected = vector<array<int, 3>>{}, directed = vector<array<int, 3>>{};
+  auto walked = vector<bool>(cells.size(), false);
+  for (int j = 0; j < (int)cells.size(); j++) {
+    if (junction[j] == -1) continue;
+    for (int d0 = 0; d0 < 4; d0++) {
+      int c = j + offsets[d0];
+      if (cells[c] == WALL || walked[c] || (junction[c] != -1 && junction[c] < junction[j])) continue;
+      // Walk the corridor, checking the slopes in both directions
+      bool forward = slopeDir(cells[j]) == -1 || slopeDir(cells[j]) == d0, backward = true;
+      int d = d0, steps = 1, last = c;
+      while (junction[c] == -1) {
+        walked[c] = true;
+        int mask = openMask(c) & ~(1 << (d ^ 2));
+        if (mask == 0) break;               // Dead end
+        int next = countr_zero((unsigned)mask);
+        int slope = slopeDir(cells[c]);
+        forward &= slope == -1 || slope == next;
+        backward &= slope == -1 || slope == (d ^ 2);
+        last = c;
+        d = next;
+        c += offsets[d];
+        steps++;
       }
+      if (junction[c] == -1 || c == j) continue;
+      if (last != c) walked[last] = true;
+      int a = junction[j], b = junction[c];
+      backward &= slopeDir(cells[c]) == -1 || slopeDir(cells[c]) == (d ^ 2);
+      undirected.push_back({a, b, steps});
+      undirected.push_back({b, a, steps});
+      if (forward) directed.push_back({a, b, steps});
+      if (backward) directed.push_back({b, a, steps});
     }
-    return succ;
-  };
+  }
+  return Maze{junction[startCell], junction[goalCell], makeGraph(n, undirected), makeGraph(n, directed)};
+}
 
-  // Usual exploration, building the graph and translating Positions to ints
-  auto posToIdx = unordered_map<Pos, int, PosHash>{ { startPos, 0 }, { goalPos, 1 } };
-  auto idxToPos = vector<Pos>{ startPos, goalPos };
-  auto frontier = deque<int>{ posToIdx[startPos] };
-  auto visited = unordered_set<int>{ };
-  auto graph = vector<vector<pair<int, int>>>{ { }, { } };   // Initial elements: startPos, goalPos
-  while (!frontier.empty()) {
-    auto current = frontier.front();
-    frontier.pop_front();
-    visited.insert(current);
-    graph[current] = toVector(
-      successors(idxToPos[current]) 
-      | views::transform([&posToIdx, &idxToPos, &graph](auto p) {
-          // Translate Positions to ints
-          auto [pos, steps] = p;
-          if (!posToIdx.contains(pos)) {
-            posToIdx[pos] = posToIdx.size();
-            idxToPos.push_back(pos);
-            graph.push_back({});
-          }
-          return make_pair(posToIdx[pos], steps);
-        }));
-    for (const auto &[pos, steps] : graph[current]) {
-      if (!visited.contains(pos) && (pos != posToIdx[goalPos])) {
-          frontier.push_back(pos);
+/**
+ * Longest simple path between two nodes of a weighted graph, by branch and bound.
+ * The search tree is split on the paths of a given depth from the start, which are
+ * taken by the threads from a shared counter as they finish the previous ones, and
+ * the best length found so far is shared by all threads. Visited nodes are a bitset
+ * of any size, and when only a few nodes are left unvisited the rest of the path is
+ * searched exhaustively, memoized by (node, visited nodes).
+ * The bound uses the best edges still usable (between unvisited nodes, or leaving
+ * the current one) around each unvisited node: the rest of the path enters and
+ * leaves each node it goes through by different edges, so twice its length is at
+ * most the sum of the best pair of edges (in and out) of each unvisited node, plus
+ * the best edge entering the goal and the best edge leaving the current node
+*/
+class LongestPathSearch {
+public:
+  LongestPathSearch(const Graph &graph, int start, int goal) : start{start}, goal{goal} {
+    int n = graph.size();
+    // If the goal can only be reached from one node, the path must go to the goal from it
+    int goalEntries = 0, lastJunction = -1;
+    for (int v = 0; v < n; v++) {
+      if (ranges::any_of(graph[v], [goal](auto e) { return e.first == goal; })) {
+        goalEntries++;
+        lastJunction = v;
       }
     }
+    auto edges = vector<array<int, 3>>{}, reversed = vector<array<int, 3>>{};
+    for (int v = 0; v < n; v++) {
+      for (auto [next, steps] : graph[v]) {
+        if (goalEntries == 1 && v == lastJunction && next != goal) continue;
+        edges.push_back({v, next, steps});
+        reversed.push_back({next, v, steps});
+      }
+    }
+    this->graph = makeGraph(n, edges);
+    entries = makeGraph(n, reversed);
+  }
+
+  /**
+   * Runs the search
+   *
+   * @param splitDepth Depth of the paths from the start that are searched as separate tasks
+   * @param memoNodes Maximum unvisited nodes for the exhaustive memoized search
+   * @return Length of the longest path, or -1 if the goal isn't reachable
+  */
+  int64_t run(int splitDepth = 6, int memoNodes = 8) {
+    this->memoNodes = memoNodes;
+    best = -1;
+    tasks.clear();
+    auto worker = Worker(graph.size());
+    auto path = vector<int>{start};
+    worker.visit(start);
+    split(path, worker, 0, splitDepth);
+
+    // Threads take the tasks as they finish the previous ones, and share the best length through best
+    return parallelReduce(tasks.size(), (int64_t)-1, [this]() { return Worker(graph.size()); },
+      [this](Worker &worker, size_t i) {
+        for (int v : tasks[i].path) worker.visit(v);
+        search(worker, tasks[i].path.back(), tasks[i].steps);
+        for (int v : tasks[i].path) worker.leave(v);
+        return best.load();
+      }, [](int64_t a, int64_t b) { return max(a, b); });
+  }
+
+private:
+  struct Task {
+    vector<int> path;
+    int steps;
+  };
+
+  struct WordsHash {
+    size_t operator()(const vector<uint64_t> &words) const {
+      size_t seed = 0;
+      for (auto w : words) hash_combine(seed, w);
+      return seed;
+    }
+  };
+
+  /**
+   * Search state of a thread: visited nodes (with an extra word for the node on the
+   * memo keys) and their count, the bound term of each unvisited node and their sum,
+   * and the changes to undo when backtracking
+  */
+  struct Worker {
+    vector<uint64_t> visited;
+    int unvisited, bound = 0;
+    vector<int> term;
+    vector<pair<int, int>> changes;
+    unordered_map<vector<uint64_t>, int, WordsHash> memo;
+
+    Worker(int n) : visited((n + 63) / 64 + 1, 0), unvisited{n}, term(n, 0) {}
+
+    bool isVisited(int v) const { return (visited[v / 64] >> (v % 64)) & 1; }
+    void visit(int v) { visited[v / 64] |= uint64_t{1} << (v % 64); unvisited--; }
+    void leave(int v) { visited[v / 64] &= ~(uint64_t{1} << (v % 64)); unvisited++; }
+  };
+
+  Graph graph, entries;
+  int start, goal, memoNodes = 0;
+  vector<Task> tasks;
+  atomic<int64_t> best;
+
+  void improve(int64_t steps) {
+    auto current = best.load();
+    while (steps > current && !best.compare_exchange_weak(current, steps));
   }
 
-  // Build adjacency matrix
-  auto adjMatrix = vector(graph.size(), vector(graph.size(), 0));
-  for (int i = 0; i < graph.size(); i++) {
-    for (auto [j, v] : graph[i]) {
-      adjMatrix[i][j] = max(adjMatrix[i][j], v);
+  // Best edges in and out of an unvisited node (from different nodes), or only in for the goal
+  int termOf(const Worker &worker, int v, int current) const {
+    int ret = 0;
+    for (auto [from, in] : entries[v]) {
+      if (from != current && worker.isVisited(from)) continue;
+      if (v == goal) {
+        ret = max(ret, in);
+        continue;
+      }
+      for (auto [to, out] : graph[v]) {
+        if (to != from && !worker.isVisited(to)) ret = max(ret, in + out);
+      }
     }
+    return ret;
   }
 
-  return make_tuple(graph, adjMatrix, posToIdx, idxToPos);
-}
+  void setTerm(Worker &worker, int v, int term) {
+    if (term == worker.term[v]) return;
+    worker.changes.push_back({v, worker.term[v]});
+    worker.bound += term - worker.term[v];
+    worker.term[v] = term;
+  }
 
-// Represents a path. Stores the last node, steps taken, 
-// visited nodes as bitset and the max possible remaining steps
-struct Path {
-  int lastNode;
-  int steps;
-  uint64_t visited;
-  int maxRemainingSteps;
-};
+  // Collects the paths of the given depth from the start as tasks (or shorter, if they can't go further)
+  void split(vector<int> &path, Worker &worker, int steps, int depth) {
+    bool expanded = false;
+    if (depth > 0 && path.back() != goal) {
+      for (auto [next, nextSteps] : graph[path.back()]) {
+        if (worker.isVisited(next)) continue;
+        expanded = true;
+        path.push_back(next);
+        worker.visit(next);
+        split(path, worker, steps + nextSteps, depth - 1);
+        worker.leave(next);
+        path.pop_back();
+      }
+    }
+    if (!expanded) tasks.push_back(Task{path, steps});
+  }
 
-int64_t longestPath(const vector<string> &grid) {
-  auto startPos = Pos{1, 0}, 
-       goalPos = Pos{(int)grid[0].size() - 2, (int)grid.size() - 1 };
-  auto [graph, adjMatrix, posToIdx, idxToPos] = gridToGraph(grid, startPos, goalPos);
-  auto start = posToIdx[startPos], goal = posToIdx[goalPos];
-
-  // Max possible steps through the graph
-  auto maxPossibleSteps = 0;
-  for (int i = 0; i < adjMatrix.size(); i++) {
-    for (int j = 0; j < i; j++) {
-      maxPossibleSteps += max(adjMatrix[i][j], adjMatrix[j][i]);
+  void search(Worker &worker, int node, int steps) {
+    worker.bound = 0;
+    for (int v = 0; v < graph.size(); v++) {
+      worker.term[v] = worker.isVisited(v) ? 0 : termOf(worker, v, node);
+      worker.bound += worker.term[v];
     }
+    dfs(worker, node, steps);
   }
 
-  // Typical DFS to generate all paths
-  auto frontier = deque<Path>{Path(start, 0, 0, maxPossibleSteps) };
-  auto maxSteps = 0;
-  while (!frontier.empty()) {
-    const auto current = frontier.front();
-    frontier.pop_front();
-    if (current.lastNode == goal) {
-      maxSteps = max(maxSteps, current.steps);
-      continue;
+  void dfs(Worker &worker, int node, int64_t steps) {
+    if (node == goal) {
+      improve(steps);
+      return;
+    }
+    int leaving = 0;
+    for (auto [next, nextSteps] : graph[node]) {
+      if (!worker.isVisited(next)) leaving = max(leaving, nextSteps);
+    }
+    if (worker.term[goal] == 0 || 2 * steps + worker.bound + leaving <= 2 * best.load(memory_order_relaxed)) return;
+    if (worker.unvisited <= memoNodes) {
+      if (auto rest = exhaustive(worker, node); rest >= 0) improve(steps + rest);
+      return;
     }
-    // If current best if >= maximum possible best, ignore this
-    if (current.steps + current.maxRemainingSteps <= maxSteps) continue;
 
-    // Unvisited nodes from the current one
-    auto unvisitedNodes = graph[current.lastNode] | 
-      views::filter([&current](const auto &p) { return !(current.visited & (1L << p.first)); });
+    for (auto [next, nextSteps] : graph[node]) {
+      if (worker.isVisited(next)) continue;
+      worker.visit(next);
+      size_t mark = worker.changes.size();
+      setTerm(worker, next, 0);
+      // The edges into next can't be used any more, and neither can the ones from the node
+      for (auto edges : { entries[next], graph[next], graph[node] }) {
+        for (auto [u, uSteps] : edges) {
+          if (!worker.isVisited(u)) setTerm(worker, u, termOf(worker, u, next));
+        }
+      }
 
-    // Sum steps from unvisited nodes
-    auto stepsOnCurrent = 0;
-    for (auto [nextNode, nextSteps] : unvisitedNodes ) {
-      stepsOnCurrent += adjMatrix[nextNode][current.lastNode];
+      dfs(worker, next, steps + nextSteps);
+
+      while (worker.changes.size() > mark) {
+        auto [v, term] = worker.changes.back();
+        worker.changes.pop_back();
+        worker.bound += term - worker.term[v];
+        worker.term[v] = term;
+      }
+      worker.leave(next);
     }
+  }
 
-    for (auto [nextNode, nextSteps] : unvisitedNodes ) {
-      // New path, update steps taken, visited and max remaining steps 
-      // by subtracting all steps from unvisited nodes to the current one
-      Path newPath{nextNode, current.steps + nextSteps, current.visited | (1L << nextNode), current.maxRemainingSteps - stepsOnCurrent};
-      frontier.push_front(newPath);
+  // Longest path from node to the goal through unvisited nodes, or -1 if there's none
+  int exhaustive(Worker &worker, int node) {
+    if (node == goal) return 0;
+    worker.visited.back() = node;
+    if (auto it = worker.memo.find(worker.visited); it != worker.memo.end()) return it->second;
+    int ret = -1;
+    for (auto [next, nextSteps] : graph[node]) {
+      if (worker.isVisited(next)) continue;
+      worker.visit(next);
+      int rest = exhaustive(worker, next);
+      worker.leave(next);
+      if (rest >= 0) ret = max(ret, rest + nextSteps);
     }
+    worker.visited.back() = node;
+    worker.memo[worker.visited] = ret;
+    return ret;
   }
-  return maxSteps;
-}
+};
 
 Result solvePartOne(const string &input) {
-  auto grid = toVector(input | splitString<string>('\n'));
-  return longestPath(grid);
+  auto maze = compress(input);
+  return LongestPathSearch(maze.directed, maze.start, maze.goal).run();
 }
 
 Result solvePartTwo(const string &input) {
-  auto grid = toVector(input 
-    | splitString<string>('\n')
-    | views::transform([](string line) {
-      replace_if(line.begin(), line.end(), [](char c) { return (c == '<' || c == '>' || c == 'v' || c == '^'); }, '.');
-      return line;
-    }));
-  return longestPath(grid);
+  auto maze = compress(input);
+  return LongestPathSearch(maze.undirected, maze.start, maze.goal).run();
 }
 } // namespace aoc23
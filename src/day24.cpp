@@ -1,4 +1,6 @@
 #include <algorithm>
+#include <array>
+#include <cmath>
 #include <iostream>
 #include <map>
 #include <numeric>
@@ -6,7 +8,8 @@
 #include <string>
 #include <string_view>
 #include <vector>
-#include <format>
+#include <optional>
+#include <cstdint>
 
 #include "aoc.h"
 #include "utils.h"
@@ -19,6 +22,9 @@ using namespace aoc;
 using Pos = vec3<int64_t>;
 using Dir = vec3<int64_t>;
 
+using int128 = __int128;
+using Vec = vec3<int128>;
+
 vector<pair<Pos, Dir>> parseInput(const string &input) {
   return toVector(input
     | splitString('\n')
@@ -31,52 +37,294 @@ vector<pair<Pos, Dir>> parseInput(const string &input) {
     }));
 }
 
-Result solvePartOne(const string &input) {
-  constexpr int64_t m = 200000000000000, M = 400000000000000;
+/**
+ * Hailstone paths projected on the xy plane, as a structure of arrays. Each path is
+ * clipped to the test window (for t >= 0), the ones that miss it are dropped, and the
+ * rest are ordered by the lowest x of their clipped segment, with the bounding box of
+ * that segment (x0, x1, y0, y1), widened by a margin that covers the rounding
+*/
+struct Paths {
+  vector<int64_t> px, py, vx, vy;
+  vector<double> x0, x1, y0, y1;
 
-  auto stones = parseInput(input);
-  auto res = int64_t{0};
+  size_t size() const { return px.size(); }
+};
+
+/**
+ * Clips the hailstone paths to the test window [lo, hi] x [lo, hi]
+ *
+ * @param stones Hailstones
+ * @param lo Lower bound of the window, on both axes
+ * @param hi Upper bound of the window, on both axes
+ * @return Clipped paths, ordered by their lowest x
+*/
+Paths clipPaths(const vector<pair<Pos, Dir>> &stones, int64_t lo, int64_t hi) {
+  const double margin = 1e-6 * (double)(hi - lo) + 1, wlo = (double)lo - margin, whi = (double)hi + margin;
+  struct Clipped {
+    int stone;
+    array<double, 4> box;
+  };
+
+  auto clipped = vector<Clipped>{};
   for (int i = 0; i < stones.size(); i++) {
-    auto [p1, v1] = stones[i];
-    auto s1 = (double)v1.y / (double)v1.x;    // Slope
-    for (int j = i + 1; j < stones.size(); j++) {
-      auto [p2, v2] = stones[j];
-      auto s2 = (double)v2.y / (double)v2.x;
-      if (s1 == s2) continue;   // Parallel lines
-      auto x = (p2.y - p1.y - s2 * p2.x + s1 * p1.x) / (s1 - s2);
-      auto t1 = (x - p1.x) / v1.x, t2 = (x - p2.x) / v2.x;
-      if (t1 < 0 || t2 < 0) continue;
-      auto y = p1.y + v1.y * t1;
-
-      res += (x >= m && x <= M && y >= m && y <= M);
+    auto [p, v] = stones[i];
+    double t0 = 0, t1 = INFINITY;
+    bool misses = false;
+    for (auto [pc, vc] : { pair{p.x, v.x}, pair{p.y, v.y} }) {
+      if (vc == 0) {
+        misses |= pc < wlo || pc > whi;
+      } else {
+        double ta = (wlo - pc) / vc, tb = (whi - pc) / vc;
+        t0 = max(t0, min(ta, tb));
+        t1 = min(t1, max(ta, tb));
+      }
     }
+    if (misses || t0 > t1) continue;
+
+    auto range = [t0, t1, margin](double pc, double vc) {
+      if (vc == 0) return pair{pc - margin, pc + margin};
+      double a = pc + vc * t0, b = pc + vc * t1;
+      return pair{min(a, b) - margin, max(a, b) + margin};
+    };
+    auto [x0, x1] = range(p.x, v.x);
+    auto [y0, y1] = range(p.y, v.y);
+    clipped.push_back({i, {x0, x1, y0, y1}});
   }
+  ranges::sort(clipped, {}, [](const auto &c) { return c.box[0]; });
 
-  return res;
+  auto paths = Paths{};
+  for (const auto &[i, box] : clipped) {
+    auto [p, v] = stones[i];
+    paths.px.push_back(p.x);
+    paths.py.push_back(p.y);
+    paths.vx.push_back(v.x);
+    paths.vy.push_back(v.y);
+    paths.x0.push_back(box[0]);
+    paths.x1.push_back(box[1]);
+    paths.y0.push_back(box[2]);
+    paths.y1.push_back(box[3]);
+  }
+  return paths;
 }
 
-Result solvePartTwo(const string &input) {
-  auto stones = parseInput(input);
-
-  cout << "Use a proper tool for the job: install python + sympy and input the following:\n\n";
-  auto times = vector{"t1"s, "t2"s, "t3"s};
-  string sympyEq{""s};
-  for (auto i = 0; i < 3; i++) {
-    auto [p, v] = stones[i+1];
-    auto t = times[i];
-    // cout << format("(x-({}))/(({})-a)=(y-({}))/(({})-b)=(z-({}))/(({})-c)\n", p.x, v.x, p.y, v.y, p.z, v.z);
-    // cout << format("{}=(x-({}))/(({})-a)\n{}==(y-({}))/(({})-b)\n{}==(z-({}))/(({})-c)\n", t, p.x, v.x, t, p.y, v.y, t, p.z, v.z);
-
-    sympyEq += format("(x-({}))/(({})-vx)-{}, (y-({}))/(({})-vy)-{}, (z-({}))/(({})-vz)-{}", p.x, v.x, t, p.y, v.y, t, p.z, v.z, t);
-    if (i!=2) sympyEq += ",";
+/**
+ * Counts the paths after path i (on the order of paths) that cross it inside the test
+ * window. Only the paths whose clipped segment starts before the one of i ends can
+ * cross it, and they are tested in blocks: first a branchless filter in T on all the
+ * block, with the y bounding boxes and exact cross products instead of slopes. Solving
+ * p_i + v_i * t = p_j + v_j * s, with D = v_i x v_j and d = p_j - p_i, gives
+ * t = (d x v_j) / D and s = (d x v_i) / D, which must both be >= 0 (parallel paths,
+ * D = 0, never cross once). The crossing point of the paths that pass is then checked
+ * against the window exactly, in 128 bits, as lo * D <= p_i * D + v_i * (d x v_j) <= hi * D
+ * (for D > 0)
+ *
+ * @tparam T Integer type where the cross products fit
+ * @param paths Clipped paths
+ * @param i Path
+ * @param lo Lower bound of the window
+ * @param hi Upper bound of the window
+ * @return Number of crossings inside the window
+*/
+template<typename T>
+int64_t crossingsAfter(const Paths &paths, size_t i, int64_t lo, int64_t hi) {
+  constexpr size_t BlockSize = 64;
+  auto end = (size_t)(ranges::upper_bound(paths.x0, paths.x1[i]) - paths.x0.begin());
+  T pix = paths.px[i], piy = paths.py[i], vix = paths.vx[i], viy = paths.vy[i];
+  double y0 = paths.y0[i], y1 = paths.y1[i];
+
+  int64_t ret = 0;
+  auto keep = array<uint8_t, BlockSize>{};
+  for (size_t b = i + 1; b < end; b += BlockSize) {
+    size_t n = min(BlockSize, end - b);
+    for (size_t k = 0; k < n; k++) {
+      size_t j = b + k;
+      T vjx = paths.vx[j], vjy = paths.vy[j], dx = paths.px[j] - pix, dy = paths.py[j] - piy;
+      T det = vix * vjy - viy * vjx, tn = dx * vjy - dy * vjx, sn = dx * viy - dy * vix;
+      bool overlaps = (paths.y0[j] <= y1) & (paths.y1[j] >= y0);
+      bool forward = ((det > 0) & (tn >= 0) & (sn >= 0)) | ((det < 0) & (tn <= 0) & (sn <= 0));
+      keep[k] = overlaps & forward;
+    }
+    for (size_t k = 0; k < n; k++) {
+      if (!keep[k]) continue;
+      size_t j = b + k;
+      int128 vjx = paths.vx[j], vjy = paths.vy[j], dx = paths.px[j] - paths.px[i], dy = paths.py[j] - paths.py[i];
+      int128 det = vix * vjy - viy * vjx, tn = dx * vjy - dy * vjx;
+      int128 x = pix * det + vix * tn, y = piy * det + viy * tn, l = lo * det, h = hi * det;
+      if (det < 0) {
+        x = -x; y = -y; l = -l; h = -h;
+      }
+      ret += (x >= l) & (x <= h) & (y >= l) & (y <= h);
+    }
+  }
+  return ret;
+}
+
+/**
+ * Number of pairs of hailstone paths that cross inside the test window (on the xy
+ * plane, going forward in time). Rows of the pair matrix (the paths after each one) are
+ * split between threads. The filter works on 64 bits when the cross products fit in
+ * them (coordinates up to 2^50 and speeds up to 2^10, as on the inputs), and on 128
+ * bits otherwise
+ *
+ * @param stones Hailstones
+ * @param lo Lower bound of the window, on both axes
+ * @param hi Upper bound of the window, on both axes
+ * @return Number of crossings
+*/
+int64_t windowCrossings(const vector<pair<Pos, Dir>> &stones, int64_t lo, int64_t hi) {
+  constexpr int64_t MaxPos = int64_t{1} << 50, MaxSpeed = int64_t{1} << 10;
+  auto paths = clipPaths(stones, lo, hi);
+  bool small = ranges::all_of(stones, [](const auto &s) {
+    auto [p, v] = s;
+    return abs(p.x) < MaxPos && abs(p.y) < MaxPos && abs(v.x) < MaxSpeed && abs(v.y) < MaxSpeed;
+  });
+
+  return parallelReduce(paths.size(), (int64_t)0, [&paths, lo, hi, small](size_t i) {
+    return small ? crossingsAfter<int64_t>(paths, i, lo, hi) : crossingsAfter<int128>(paths, i, lo, hi);
+  }, plus<int64_t>{});
+}
+
+Result solvePartOne(const string &input) {
+  constexpr int64_t m = 200000000000000, M = 400000000000000;
+  return windowCrossings(parseInput(input), m, M);
+}
+
+// Rock position and velocity
+struct Rock {
+  Vec p, v;
+};
+
+Vec widen(const vec3<int64_t> &a) {
+  return Vec{a.x, a.y, a.z};
+}
+
+/**
+ * Cross product, flagging overflow (like the Lagoon of day 18, the flag is sticky)
+*/
+Vec cross(const Vec &a, const Vec &b, bool &overflow) {
+  auto term = [&overflow](int128 a, int128 b, int128 c, int128 d) {
+    int128 ab, cd, ret;
+    overflow |= __builtin_mul_overflow(a, b, &ab);
+    overflow |= __builtin_mul_overflow(c, d, &cd);
+    overflow |= __builtin_sub_overflow(ab, cd, &ret);
+    return ret;
+  };
+  return Vec{term(a.y, b.z, a.z, b.y), term(a.z, b.x, a.x, b.z), term(a.x, b.y, a.y, b.x)};
+}
+
+int128 gcd128(int128 a, int128 b) {
+  if (a < 0) a = -a;
+  if (b < 0) b = -b;
+  while (b != 0) a = exchange(b, a % b);
+  return a;
+}
+
+// Small enough that products with other small values or input coordinates can't overflow
+bool isSmall(int128 v) {
+  return v > -((int128)1 << 62) && v < ((int128)1 << 62);
+}
+
+/**
+ * Time when a point starting at p with velocity v crosses the line through the origin
+ * along d, which happens when (p + v * t) x d = 0, or p x d + t * (v x d) = 0
+ *
+ * @return The time, or nullopt if it never crosses the line at an integer time (or
+ * is always on it)
+*/
+optional<int128> crossingTime(const Vec &p, const Vec &v, const Vec &d) {
+  bool overflow = false;
+  auto a = cross(p, d, overflow), b = cross(v, d, overflow);
+  if (overflow) return nullopt;
+  for (auto [ac, bc] : { pair{a.x, b.x}, pair{a.y, b.y}, pair{a.z, b.z} }) {
+    if (bc == 0) continue;
+    if (ac % bc != 0) return nullopt;
+    int128 t = -ac / bc;
+    if (!isSmall(t) || a + b * t != Vec{0, 0, 0}) return nullopt;
+    return t;
+  }
+  return nullopt;
+}
+
+/**
+ * Checks that the rock hits a stone, at an integer time t >= 0 where p + v * t is the
+ * same for both
+*/
+bool hits(const Rock &rock, const Vec &p, const Vec &v) {
+  auto dp = p - rock.p, dv = rock.v - v;   // dp = dv * t
+  for (auto [pc, vc] : { pair{dp.x, dv.x}, pair{dp.y, dv.y}, pair{dp.z, dv.z} }) {
+    if (vc == 0) continue;
+    if (pc % vc != 0) return false;
+    int128 t = pc / vc;
+    return t >= 0 && dv * t == dp;
   }
-  cout << "from sympy import solve\n";
-  cout << "from sympy import symbols\n";
-  cout << "x,y,z,vx,vy,vz,t1,t2,t3=symbols(\"x,y,z,vx,vy,vz,t1,t2,t3\")\n";
-  cout << format("sol=solve([{}], [x,y,z,vx,vy,vz,t1,t2,t3], dict=True)\n", sympyEq);
-  // cout << "print(sol)\n";
-  cout << "print(\"x: \" + str(sol[0][x]) + \", y: \" + str(sol[0][y]) + \", z: \" + str(sol[0][z]))\n";
-  cout << "print(\"sum: \" + str(sol[0][x] + sol[0][y] + sol[0][z]))\n\n";
-  return 261502975177164 + 428589795012222 + 196765966839909;  // 886858737029295
+  return dp == Vec{0, 0, 0};   // Same velocity, so it must start on the stone
+}
+
+/**
+ * Rock that hits stones i and j, seen from stone b. On the frame of stone b the rock
+ * passes through the origin (where b stays), and crosses the paths of i and j, so its
+ * direction lies on the planes through the origin and each of those paths. The normal
+ * of each plane is p x v (on that frame), and crossing both normals eliminates the
+ * rock position, leaving the rock direction, reduced by the gcd of its coordinates.
+ * The times when the rock meets i and j are then exact divisions, and from the two
+ * collision points come the rock velocity and position
+ *
+ * @return The rock, or nullopt if the stones are degenerate (parallel planes,
+ * simultaneous collisions) or the values don't fit in 128 bits
+*/
+optional<Rock> throwRock(const vector<pair<Pos, Dir>> &stones, int b, int i, int j) {
+  auto pb = widen(stones[b].first), vb = widen(stones[b].second);
+  auto pi = widen(stones[i].first) - pb, vi = widen(stones[i].second) - vb;
+  auto pj = widen(stones[j].first) - pb, vj = widen(stones[j].second) - vb;
+
+  bool overflow = false;
+  auto d = cross(cross(pi, vi, overflow), cross(pj, vj, overflow), overflow);
+  int128 g = gcd128(gcd128(d.x, d.y), d.z);
+  if (overflow || g == 0) return nullopt;
+  d = Vec{d.x / g, d.y / g, d.z / g};
+  if (!isSmall(d.x) || !isSmall(d.y) || !isSmall(d.z)) return nullopt;
+
+  auto ti = crossingTime(pi, vi, d), tj = crossingTime(pj, vj, d);
+  if (!ti || !tj || *ti == *tj) return nullopt;
+  // Collision points, back on the original frame
+  auto ci = widen(stones[i].first) + widen(stones[i].second) * *ti;
+  auto cj = widen(stones[j].first) + widen(stones[j].second) * *tj;
+  auto delta = cj - ci;
+  int128 dt = *tj - *ti;
+  if (delta.x % dt != 0 || delta.y % dt != 0 || delta.z % dt != 0) return nullopt;
+  auto v = Vec{delta.x / dt, delta.y / dt, delta.z / dt};
+  if (!isSmall(v.x) || !isSmall(v.y) || !isSmall(v.z)) return nullopt;
+  return Rock{ci - v * *ti, v};
+}
+
+/**
+ * Finds the rock that hits all stones, trying a few triples of stones until one isn't
+ * degenerate, and verifying the rock against all the stones
+ *
+ * @param stones Hailstones
+ * @return The rock, or nullopt if there's none
+*/
+optional<Rock> findRock(const vector<pair<Pos, Dir>> &stones) {
+  constexpr int MaxStones = 8;
+  int n = min<int>(stones.size(), MaxStones);
+  for (int b = 0; b < n; b++) {
+    for (int i = 0; i < n; i++) {
+      for (int j = i + 1; j < n; j++) {
+        if (i == b || j == b) continue;
+        auto rock = throwRock(stones, b, i, j);
+        if (rock && ranges::all_of(stones, [&rock](const auto &s) { return hits(*rock, widen(s.first), widen(s.second)); }))
+          return rock;
+      }
+    }
+  }
+  return nullopt;
+}
+
+Result solvePartTwo(const string &input) {
+  auto rock = findRock(parseInput(input));
+  if (!rock) return monostate();
+  int128 ret = rock->p.x + rock->p.y + rock->p.z;
+  if (ret < INT64_MIN || ret > INT64_MAX) return monostate();
+  return (int64_t)ret;
 }
 } // namespace aoc24
@@ -1,4 +1,6 @@
+#include <algorithm>
 #include <iostream>
+#include <limits>
 #include <map>
 #include <numeric>
 #include <ranges>
@@ -16,100 +18,135 @@ namespace aoc5 {
 using namespace std;
 using namespace aoc;
 
-// Aux struct representing a conversion map
-struct AlmanacMap {
-  string_view name;
-  vector<vector<int64_t>> mappings;
+constexpr int64_t DomainEnd = numeric_limits<int64_t>::max();
+
+// A single rule of a map, converting [src, src + len) to [dest, dest + len)
+struct Rule {
+  int64_t dest, src, len;
+};
+
+/**
+ * Piecewise-linear function over [0, DomainEnd), stored as a flat table of segments
+ * sorted by their start. Segment i covers [starts[i], starts[i + 1]) and maps each
+ * value in it to value + offsets[i]. Values not covered by any rule have offset 0
+*/
+struct PiecewiseMap {
+  vector<int64_t> starts, offsets;
+
+  size_t size() const { return starts.size(); }
+  int64_t end(size_t i) const { return (i + 1 < starts.size()) ? starts[i + 1] : DomainEnd; }
+
+  // Appends a segment, merging it with the previous one if they share the offset
+  void append(int64_t start, int64_t offset) {
+    if (!offsets.empty() && offsets.back() == offset) return;
+    starts.push_back(start);
+    offsets.push_back(offset);
+  }
+
+  // Index of the segment containing val
+  size_t segmentOf(int64_t val) const {
+    return ranges::upper_bound(starts, val) - starts.begin() - 1;
+  }
+
+  int64_t operator()(int64_t val) const {
+    return val + offsets[segmentOf(val)];
+  }
 };
 
-pair<vector<int64_t>, vector<AlmanacMap>> parseInput(const string &input) {
+// Builds the flat interval table of a map from its (unsorted) rules
+PiecewiseMap buildMap(vector<Rule> &rules) {
+  ranges::sort(rules, {}, &Rule::src);
+
+  auto res = PiecewiseMap{};
+  int64_t pos = 0;
+  for (const auto &r : rules) {
+    if (r.src > pos) res.append(pos, 0);
+    res.append(r.src, r.dest - r.src);
+    pos = r.src + r.len;
+  }
+  res.append(pos, 0);
+  return res;
+}
+
+/**
+ * Composes two maps, returning a map equivalent to applying first and then second.
+ * Each segment of first is split by the segments of second covering its image
+*/
+PiecewiseMap compose(const PiecewiseMap &first, const PiecewiseMap &second) {
+  auto res = PiecewiseMap{};
+  for (size_t i = 0; i < first.size(); i++) {
+    auto off = first.offsets[i];
+    auto imgStart = first.starts[i] + off,
+         imgEnd = (first.end(i) == DomainEnd) ? DomainEnd : first.end(i) + off;
+    for (auto j = second.segmentOf(imgStart); imgStart < imgEnd; imgStart = second.end(j++)) {
+      res.append(imgStart - off, off + second.offsets[j]);
+    }
+  }
+  return res;
+}
+
+// Parses the seeds and composes all maps into a single seed to location map
+pair<vector<int64_t>, PiecewiseMap> parseInput(const string &input) {
   auto lines = input | splitString('\n');
   auto seeds = toVector(lines.front().substr(6) | splitNumbers<int64_t>(' '));
 
-  auto allMaps = vector<AlmanacMap>{};
+  // Identity, composed with each map as it is parsed
+  auto almanac = PiecewiseMap{{0}, {0}};
+  auto rules = vector<Rule>{};
   for (auto l : lines | views::drop(1)) {
-    auto tokenPos = l.find(" map:");
-    if (tokenPos != string::npos) {
-      auto newMap = AlmanacMap(l.substr(0, tokenPos), {});
-      allMaps.push_back(newMap);
+    if (l.find(" map:") != string::npos) {
+      if (!rules.empty()) almanac = compose(almanac, buildMap(rules));
+      rules.clear();
     } else {
-      auto newMappings = toVector(l | splitNumbers<int64_t>(' '));
-      allMaps.back().mappings.push_back(newMappings);
+      auto it = (l | splitNumbers<int64_t>(' ')).begin();
+      auto dest = *it, src = *++it, len = *++it;
+      rules.push_back(Rule{dest, src, len});
     }
   }
-  return make_pair(seeds, allMaps);
+  if (!rules.empty()) almanac = compose(almanac, buildMap(rules));
+  return make_pair(seeds, almanac);
 }
 
-Result solvePartOne(const string &input) {
-  auto [seeds, allMaps] = parseInput(input);
-
-  // Pass each seed through the maps, converting it
-  auto mappedSeeds = seeds | views::transform([&allMaps](auto seed) {
-      for (auto singleMap : allMaps) {
-        for (auto m : singleMap.mappings) {
-          auto start = m[1], len = m[2], end = start + len, convert = m[0];
-          if (seed >= start && seed < end) {
-            seed += convert - start;
-            break;
-          }
-        }
-      }
-      return seed;
-    });
-
-  return foldLeft(mappedSeeds, mappedSeeds.front(), ranges::min);
+/**
+ * Lowest location for a batch of seed ranges [start, end). The ranges are sorted and
+ * merged, and then swept alongside the segments of the map. As the map is increasing
+ * inside each segment, the minimum on a segment is at the start of its overlap
+*/
+int64_t minLocation(vector<pair<int64_t, int64_t>> seedRanges, const PiecewiseMap &almanac) {
+  ranges::sort(seedRanges);
+
+  auto best = DomainEnd;
+  size_t j = 0;
+  for (size_t i = 0; i < seedRanges.size(); ) {
+    auto [start, end] = seedRanges[i];
+    for (i++; i < seedRanges.size() && seedRanges[i].first <= end; i++) {
+      end = max(end, seedRanges[i].second);
+    }
+    while (almanac.end(j) <= start) j++;
+    // The last segment visited is kept, as it may extend to the next range
+    for (auto pos = start; pos < end; pos = almanac.end(j++)) {
+      best = min(best, pos + almanac.offsets[j]);
+      if (almanac.end(j) >= end) break;
+    }
+  }
+  return best;
 }
 
-Result solvePartTwo(const string &input) {
-  auto [auxSeeds, allMaps] = parseInput(input);
+Result solvePartOne(const string &input) {
+  auto [seeds, almanac] = parseInput(input);
 
-  auto seeds = vector<pair<int64_t, int64_t>>{}, 
-       mappedSeeds = vector<pair<int64_t, int64_t>>{};
-  // Join seeds in pairs [start, len)
-  for (int i = 0; i < auxSeeds.size(); i += 2) {
-    seeds.push_back(make_pair(auxSeeds[i], auxSeeds[i+1]));
-  }
+  auto mappedSeeds = seeds | views::transform(almanac);
+  return foldLeft(mappedSeeds, DomainEnd, ranges::min);
+}
 
-  // Iterate over maps now
-  for (auto singleMap : allMaps) {
-
-    // Use seeds as a queue
-    while (!seeds.empty()) {
-      auto newSeed = seeds.back();
-      seeds.pop_back();
-      auto [seedStart, seedLen] = newSeed;
-      auto seedEnd = seedStart + seedLen;
-
-      // Convert a single seed. If necessary, partition it and queue the segments not converted
-      for (auto m : singleMap.mappings) {
-        auto mapStart = m[1], mapLen = m[2], mapEnd = mapStart + mapLen, mapConvert = m[0];
-        if (seedStart < mapStart && seedEnd > mapStart) {
-          // Partition first segment and queue it, convert middle segment
-          seeds.push_back(make_pair(seedStart, mapStart - seedStart));
-          newSeed = make_pair(mapConvert, min(mapLen, seedEnd - mapStart));
-          // If final segment exists, queue it
-          if (seedEnd > mapEnd) seeds.push_back(make_pair(mapEnd, seedEnd - mapEnd));
-          break;
-        }
-
-        if (seedStart >= mapStart && seedStart < mapEnd) {
-          // Convert first segment and if second segment exists, queue it
-          newSeed = make_pair(mapConvert + seedStart - mapStart, min(seedLen, mapEnd - seedStart));
-          if (seedEnd > mapEnd) seeds.push_back(make_pair(mapEnd, seedEnd - mapEnd));
-          break;
-        }
-      }
-      mappedSeeds.push_back(newSeed);
-    }
+Result solvePartTwo(const string &input) {
+  auto [auxSeeds, almanac] = parseInput(input);
 
-    // Finished this map converting all seeds, swap them to go to the next map
-    swap(seeds, mappedSeeds);
+  // Join seeds in pairs [start, end)
+  auto seedRanges = vector<pair<int64_t, int64_t>>{};
+  for (int i = 0; i + 1 < auxSeeds.size(); i += 2) {
+    seedRanges.push_back(make_pair(auxSeeds[i], auxSeeds[i] + auxSeeds[i + 1]));
   }
-
-  return foldLeft(seeds, get<0>(seeds.front()), [](auto m, auto seed) {
-    return min(m, get<0>(seed));
-  });
-
-  return 0;
+  return minLocation(std::move(seedRanges), almanac);
 }
 } // namespace aoc5
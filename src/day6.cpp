@@ -3,10 +3,12 @@
 #include <map>
 #include <numeric>
 #include <ranges>
+#include <span>
 #include <string>
 #include <string_view>
 #include <vector>
 #include <cmath>
+#include <cstdint>
 
 #include "aoc.h"
 #include "utils.h"
@@ -16,37 +18,92 @@ namespace aoc6 {
 using namespace std;
 using namespace aoc;
 
+using int128 = __int128;
+
+/**
+ * Exact integer square root of n, given an estimate of it (usually from floating
+ * point). A Newton step removes most of the estimate's error, the remaining
+ * off-by-one is corrected so that r*r <= n < (r+1)*(r+1)
+ *
+ * @param n Number, up to 2^126
+ * @param estimate Approximate square root
+ * @return floor(sqrt(n))
+*/
+constexpr int128 isqrt(int128 n, int128 estimate) {
+  if (n <= 0) return 0;
+  auto r = (estimate > 0) ? (estimate + n / estimate) / 2 : n;
+  while (r > n / r) r = (r + n / r) / 2;
+  while (r + 1 <= n / (r + 1)) r++;
+  return r;
+}
+
+inline int128 isqrt(int128 n) {
+  return isqrt(n, (int128)sqrtl((long double)n));
+}
+
+/**
+ * Number of ways to win a race. Distance is given by d(t) = t(T-t), so the
+ * solution is d(t) > D. The quadratic formula gives the roots (T -+ sqrt(T^2 - 4D)) / 2,
+ * which are computed with an exact integer square root, and then the first winning
+ * hold time is adjusted on the boundary. By symmetry the last one is T - first
+ *
+ * @param time Race time (T), up to 2^62 so that all intermediate values fit
+ * @param dist Record distance (D)
+ * @param root Integer square root of T^2 - 4D
+ * @return Number of integer hold times that beat the record
+*/
+constexpr int128 waysToWin(int128 time, int128 dist, int128 root) {
+  auto first = max<int128>((time - root) / 2, 0);
+  while (first > 0 && (first - 1) * (time - first + 1) > dist) first--;
+  while (2 * first <= time && first * (time - first) <= dist) first++;
+  return (2 * first <= time) ? time - 2 * first + 1 : 0;
+}
+
+inline int128 waysToWin(int128 time, int128 dist) {
+  auto disc = time * time - 4 * dist;
+  return (disc < 0) ? 0 : waysToWin(time, dist, isqrt(disc));
+}
+
+/**
+ * Batch version, for many races at once. The square roots are first estimated in
+ * floating point for all races, in a loop without dependencies that the compiler
+ * can vectorize, and each one is then corrected to the exact integer result
+ *
+ * @param times Race times
+ * @param dists Record distances
+ * @param ways Output, number of ways to win each race
+*/
+void waysToWin(span<const int64_t> times, span<const int64_t> dists, span<int64_t> ways) {
+  auto estimates = vector<double>(times.size());
+  for (size_t i = 0; i < times.size(); i++) {
+    double t = times[i], d = dists[i];
+    estimates[i] = sqrt(max(t * t - 4 * d, 0.0));
+  }
+  for (size_t i = 0; i < times.size(); i++) {
+    int128 t = times[i], d = dists[i], disc = t * t - 4 * d;
+    ways[i] = (disc < 0) ? 0 : (int64_t)waysToWin(t, d, isqrt(disc, (int128)estimates[i]));
+  }
+}
+
 Result solvePartOne(const string &input) {
-  auto params = toVector(input 
+  auto params = toVector(input
     | splitString('\n')
     | views::transform([](auto line) {
-      return toVector(line.substr(line.find(":") + 1) | splitNumbers(' '));
+      return toVector(line.substr(line.find(":") + 1) | splitNumbers<int64_t>(' '));
     }));
 
-  // Distance is given by d(t) = t(T-t), so the solution is d(t) > D, with T 
-  // and D given in the input. Apply quadratic formula to get (minT, maxT)
-  // Solutions are the integers in the interval (minT, maxT)
-  auto ret = 1;
-  for (int i = 0; i < params[0].size(); i++) {
-    auto T = params[0][i], D = params[1][i];
-    auto minT = (T - sqrt(T*T - 4*D)) / 2,
-      maxT = (T + sqrt(T*T - 4*D)) / 2;
-      ret *= ceil(maxT) - floor(minT) - 1;
-  }
-
-  return ret;
+  auto ways = vector<int64_t>(params[0].size());
+  waysToWin(params[0], params[1], ways);
+  return foldLeft(ways, (int64_t)1, multiplies<int64_t>());
 }
 
 Result solvePartTwo(const string &input) {
-  auto params = toVector(input 
+  auto params = toVector(input
     | splitString('\n')
     | views::transform([](auto line) {
       auto lineNumbers = line | views::filter(::isdigit);
-      return ston<int64_t>(string(lineNumbers.begin(), lineNumbers.end()));
+      return ston<int128>(string(lineNumbers.begin(), lineNumbers.end()));
     }));
-  auto T = params[0], D = params[1];
-  auto minT = (T - sqrt(T*T - 4*D)) / 2,
-    maxT = (T + sqrt(T*T - 4*D)) / 2;
-  return (int)ceil(maxT) - (int)floor(minT) - 1;
+  return (int64_t)waysToWin(params[0], params[1]);
 }
 } // namespace aoc6
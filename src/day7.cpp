@@ -1,12 +1,12 @@
 #include <algorithm>
+#include <array>
 #include <iostream>
 #include <numeric>
 #include <ranges>
 #include <string>
 #include <string_view>
 #include <vector>
-#include <unordered_map>
-#include <set>
+#include <cstdint>
 
 #include "aoc.h"
 #include "utils.h"
@@ -16,77 +16,86 @@ namespace aoc7 {
 using namespace std;
 using namespace aoc;
 
-class Hand {
-public:
-  string_view hand;
-  int bid;
+// Rank of each card, from 0 to 12, as a lookup table indexed by the card char.
+// With jokers, 'J' becomes the lowest card and the ones bellow it are shifted up
+constexpr array<uint8_t, 256> makeRanks(bool useJokers) {
+  auto ranks = array<uint8_t, 256>{};
+  string_view order = useJokers ? "J23456789TQKA" : "23456789TJQKA";
+  for (int i = 0; i < order.size(); i++) ranks[(uint8_t)order[i]] = i;
+  return ranks;
+}
 
-  Hand(string_view h, int b, bool useJokers = false) : hand{h}, bid{b} {
-    typeScore = useJokers ? scoreWithJokers(h) : score(h);
-    // Substitute AKQJT for chars in lexicographic order, so that we can
-    // later simply compare 2 strings and get a ordering out of them
-    auto valueMap = unordered_map<char, char>{{'A', 'e'}, {'K', 'd'}, {'Q', 'c'}, {'J', useJokers ? '0' : 'b'}, {'T', 'a'}};
-    ranges::copy(hand 
-      | views::transform([&valueMap](char c) {
-        return valueMap.contains(c) ? valueMap[c] : c;
-      }),
-      back_inserter(compareHand));
-  }
+constexpr auto cardRanks = makeRanks(false), jokerRanks = makeRanks(true);
 
-  // Comparison operator for posterior sort
-  inline friend bool operator< (const Hand& lhs, const Hand& rhs) { 
-    return lhs.typeScore < rhs.typeScore ||
-      (lhs.typeScore == rhs.typeScore && lhs.compareHand < rhs.compareHand);
+/**
+ * Encodes a hand into a single sort key: the type of the hand on the high nibble
+ * (bits 20 to 23, from 0 for high card to 6 for five of a kind) followed by the
+ * rank of each of the 5 cards in 4 bits, so that comparing keys orders the hands.
+ * The type is derived from the 2 highest card counts, with jokers (rank 0 when
+ * used) always joining the most frequent card
+ *
+ * @param hand Hand to encode
+ * @param useJokers Whether 'J' is a joker
+ * @return Sort key
+*/
+constexpr uint32_t encodeHand(string_view hand, bool useJokers) {
+  const auto &ranks = useJokers ? jokerRanks : cardRanks;
+  auto counts = array<uint8_t, 13>{};
+  uint32_t key = 0;
+  for (char c : hand) {
+    key = (key << 4) | ranks[(uint8_t)c];
+    counts[ranks[(uint8_t)c]]++;
   }
 
-private:
-  // Auxiliary fields
-  int typeScore;
-  string compareHand;
-
-  static int score(string_view hand) {
-    // Calculate hand typeScore, by checking how many different cards there are
-    auto cardCounts = unordered_map<char, int>{};
-    for (char c : hand) cardCounts[c]++;
-    return accumulate(hand.begin(), hand.end(), 0, [&cardCounts](int p, char c) { return p + cardCounts[c]; } );
+  int jokers = useJokers ? counts[0] : 0;
+  if (useJokers) counts[0] = 0;
+  int first = 0, second = 0;
+  for (int c : counts) {
+    if (c > first) {
+      second = first;
+      first = c;
+    } else if (c > second) {
+      second = c;
+    }
   }
+  first += jokers;
 
-  static int scoreWithJokers(string_view hand) {
-    // Get the unique cards to try in the hand, except the joker
-    auto uniqueChars = set(hand.begin(), hand.end());
-    uniqueChars.erase('J');
-    // Degenerate case of hand with all Jokers
-    if (uniqueChars.empty()) return score(hand);
+  uint32_t type = (first == 5) ? 6 : (first == 4) ? 5 : (first == 3) ? ((second == 2) ? 4 : 3)
+    : (first == 2) ? ((second == 2) ? 2 : 1) : 0;
+  return (type << 20) | key;
+}
 
-    // Substitute jokers and get the maximum score
-    int maxScore = 0;
-    for (char c : uniqueChars) {
-      auto newHand = string{hand};
-      replace(newHand.begin(), newHand.end(), 'J', c);
-      maxScore = max(maxScore, score(newHand));
-    }
-    return maxScore;
+/**
+ * LSD radix sort, on 8 bit digits, of values with the sort key on bits [fromBit, toBit)
+ *
+ * @param values Values to sort
+ * @param fromBit First bit of the key
+ * @param toBit Last bit (exclusive) of the key
+*/
+void radixSort(vector<uint64_t> &values, int fromBit, int toBit) {
+  auto aux = vector<uint64_t>(values.size());
+  for (int shift = fromBit; shift < toBit; shift += 8) {
+    auto offsets = array<size_t, 257>{};
+    for (auto v : values) offsets[((v >> shift) & 0xFF) + 1]++;
+    partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    for (auto v : values) aux[offsets[(v >> shift) & 0xFF]++] = v;
+    swap(values, aux);
   }
-};
-
-// Parse input into a vector of hands
-vector<Hand> parseInput(const string &input, bool useJokers) {
-  return toVector(input 
-    | splitString('\n')
-    | views::transform([useJokers](auto line) {
-      size_t pos = line.find(' ');
-      return Hand(line.substr(0, pos), ston<int>(line.substr(pos+1)), useJokers);
-    }));
 }
 
 Result solve(const string &input, bool useJokers) {
-  auto hands = parseInput(input, useJokers);
-  sort(hands.begin(), hands.end());
+  // Each hand is stored with its key on the high 32 bits and its bid on the low ones
+  auto hands = vector<uint64_t>{};
+  for (auto line : input | splitString('\n')) {
+    size_t pos = line.find(' ');
+    auto key = encodeHand(line.substr(0, pos), useJokers);
+    hands.push_back(((uint64_t)key << 32) | ston<uint32_t>(line.substr(pos + 1)));
+  }
+  radixSort(hands, 32, 56);
 
-  // having enumerate would be nice...
-  int ret = 0;
-  for (int i = 0; i < hands.size(); i++) {
-    ret += (i + 1) * hands[i].bid;
+  int64_t ret = 0;
+  for (int64_t i = 0; i < hands.size(); i++) {
+    ret += (i + 1) * (int64_t)(hands[i] & 0xFFFFFFFF);
   }
   return ret;
 }
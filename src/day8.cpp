@@ -1,13 +1,13 @@
 #include <algorithm>
 #include <iostream>
-#include <unordered_map>
 #include <numeric>
+#include <optional>
 #include <ranges>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <vector>
 #include <utility>
-#include <numeric>
 #include <cstdint>
 
 #include "aoc.h"
@@ -18,55 +18,121 @@ namespace aoc8 {
 using namespace std;
 using namespace aoc;
 
-using Graph = unordered_map<string_view, pair<string_view, string_view>>;
+// Nodes are identified by their label interpreted as a 3 digit base-36 number
+constexpr uint32_t NodeCount = 36 * 36 * 36;
+constexpr uint32_t NodeMask = 0xFFFF;
+
+constexpr uint32_t nodeId(string_view label) { return ston<uint32_t>(label, 36); }
+// Last char of the label, as a base-36 digit
+constexpr bool endsWith(uint32_t node, char c) { return node % 36 == nodeId(string_view(&c, 1)); }
+
+/**
+ * Graph as a flat table indexed by node id, where each entry holds the id of the
+ * left node on the low 16 bits and the right one on the high 16 bits. The path is
+ * kept as the shift to apply to an entry to get the next node (0 for L, 16 for R)
+*/
+struct Graph {
+  vector<uint32_t> successors;
+  vector<uint8_t> path;
+
+  uint32_t next(uint32_t node, size_t step) const {
+    return (successors[node] >> path[step]) & NodeMask;
+  }
+};
 
-// Return input parsed as a pair <path, graph as a map>
-pair<string_view, Graph> parseInput(const string &input) {
+Graph parseInput(const string &input) {
   auto lines = input | splitString('\n');
 
-  auto path = lines.front();
-  auto graph = Graph{};
+  auto graph = Graph{vector<uint32_t>(NodeCount), {}};
+  // Nodes not on the input are dead ends, looping to themselves
+  for (uint32_t i = 0; i < NodeCount; i++) graph.successors[i] = (i << 16) | i;
+  for (char c : lines.front()) graph.path.push_back((c == 'L') ? 0 : 16);
   for (auto l : lines | views::drop(1)) {
-    graph[l.substr(0, 3)] = make_pair(l.substr(7, 3), l.substr(12, 3));
+    graph.successors[nodeId(l.substr(0, 3))] = (nodeId(l.substr(12, 3)) << 16) | nodeId(l.substr(7, 3));
   }
-  return make_pair(path, graph);
+  return graph;
 }
 
-// Traverses the `graph`, starting on `start`, following `path` and stopping when `isEndNode` returns true
-int traverse(Graph &graph, string_view start, string_view path, auto isEndNode) {
-  int steps = 0;
-  auto nextNode = start, node = nextNode;
-  // Loop on path until final node found
-  for (int i = 0; !isEndNode(node); i = (i+1) % path.length(), steps++, node = nextNode) {
-    nextNode = (path[i] == 'L') ? graph[node].first : graph[node].second;
-    // Simple sanity check, to avoid obvious loops
-    if (nextNode == node) {
-      // cout << "Dead end detected, bailing out...\n";
-      return -1;
+/**
+ * Finds the cycle of a ghost starting on `start`, using Brent's algorithm on the
+ * state (node, path index), and then walks the path up to the end of the first
+ * cycle to collect the steps where it is on an end node
+ *
+ * @param graph Graph
+ * @param start Start node
+ * @param isEndNode Predicate for end nodes
+ * @return Steps where the ghost is on an end node
+*/
+PeriodicEvents findCycle(const Graph &graph, uint32_t start, auto isEndNode) {
+  using State = pair<uint32_t, size_t>;
+  auto advance = [&graph](State s) {
+    return State{graph.next(s.first, s.second), (s.second + 1 == graph.path.size()) ? 0 : s.second + 1};
+  };
+
+  // Find the period, advancing the hare with increasing powers of 2
+  auto tortoise = State{start, 0}, hare = advance(tortoise);
+  int64_t power = 1, period = 1;
+  for (; tortoise != hare; hare = advance(hare), period++) {
+    if (power == period) {
+      tortoise = hare;
+      power *= 2;
+      period = 0;
     }
   }
-  return steps;
+
+  // Find the offset, with the hare one period ahead of the tortoise
+  tortoise = hare = State{start, 0};
+  for (int64_t i = 0; i < period; i++) hare = advance(hare);
+  int64_t offset = 0;
+  for (; tortoise != hare; tortoise = advance(tortoise), hare = advance(hare)) offset++;
+
+  auto ret = PeriodicEvents{offset, period, {}, {}};
+  auto s = State{start, 0};
+  for (int64_t t = 0; t < offset + period; t++, s = advance(s)) {
+    if (!isEndNode(s.first)) continue;
+    if (t < offset) ret.before.push_back(t);
+    else ret.residues.push_back(t % period);
+  }
+  ranges::sort(ret.residues);
+  return ret;
 }
 
 Result solvePartOne(const string &input) {
-  auto [path, graph] = parseInput(input);
+  auto graph = parseInput(input);
 
-  int steps = traverse(graph, "AAA", path, [](string_view node) { return node == "ZZZ"; });
-  if (steps >= 0) 
-    return steps;
+  auto end = nodeId("ZZZ");
+  auto cycle = findCycle(graph, nodeId("AAA"), [end](uint32_t node) { return node == end; });
+  auto steps = firstCommonEvent({cycle});
+  if (steps)
+    return *steps;
   else
     return monostate();
 }
 
 Result solvePartTwo(const string &input) {
-  auto [path, graph] = parseInput(input);
-  // Get path lengths from nodes ending with 'A' to nodes ending with 'Z'
-  auto pathLen = graph
-    | views::filter([](auto p) { return p.first.back() == 'A'; })
-    | views::transform([&graph, &path](auto p) { 
-        return traverse(graph, p.first, path, [](auto node) { return node.back() == 'Z'; }); 
+  auto graph = parseInput(input);
+
+  // Start nodes are the ones ending with 'A' on the input
+  auto starts = vector<uint32_t>{};
+  for (auto l : input | splitString('\n') | views::drop(1)) {
+    if (l[2] == 'A') starts.push_back(nodeId(l.substr(0, 3)));
+  }
+
+  // Each ghost is followed on its own thread
+  auto ghosts = vector<PeriodicEvents>(starts.size());
+  {
+    auto threads = vector<jthread>{};
+    for (size_t i = 0; i < starts.size(); i++) {
+      threads.emplace_back([&graph, &ghosts, &starts, i]() {
+        ghosts[i] = findCycle(graph, starts[i], [](uint32_t node) { return endsWith(node, 'Z'); });
       });
-  // Just assume that all paths loop when reaching the end node, and return the LCM
-  return foldLeft(pathLen, (int64_t)1, lcm<int64_t, int64_t>);
+    }
+  }
+
+  auto steps = firstCommonEvent(ghosts);
+  if (steps)
+    return *steps;
+  else
+    return monostate();
 }
 } // namespace aoc8
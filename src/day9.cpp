@@ -1,11 +1,15 @@
 #include <algorithm>
+#include <array>
 #include <iostream>
 #include <map>
 #include <numeric>
+#include <optional>
 #include <ranges>
+#include <span>
 #include <string>
 #include <string_view>
 #include <vector>
+#include <cstdint>
 
 #include "aoc.h"
 #include "utils.h"
@@ -15,46 +19,98 @@ namespace aoc9 {
 using namespace std;
 using namespace aoc;
 
-// Returns a vector of the differences
-vector<int64_t> diff(const vector<int64_t> &in) {
-  auto out = vector<int64_t>(in.size() - 1);
-  for (int i = 0; i < in.size() - 1; i++) {
-    out[i] = in[i+1] - in[i];
+using int128 = __int128;
+
+// Longest sequence supported, up to 63 so that the sum of the absolute weights
+// (2^n - 1) fits in int64_t
+constexpr int MaxLength = 63;
+
+/**
+ * Extrapolating a sequence of length n by repeatedly taking differences until
+ * they're constant is the same as a weighted sum of its elements, with alternating
+ * binomial weights: next = sum((-1)^(n-1-i) * C(n, i) * x_i). The previous element
+ * is the same sum with the weights mirrored, as it is the next of the reversed sequence
+ *
+ * Weights tables, indexed by sequence length n and element position i
+*/
+struct Weights {
+  array<array<int64_t, MaxLength>, MaxLength + 1> next{}, prev{};
+  // Sum of the absolute weights, to bound the result
+  array<int64_t, MaxLength + 1> absSum{};
+};
+
+constexpr Weights makeWeights() {
+  auto w = Weights{};
+  for (int n = 1; n <= MaxLength; n++) {
+    int64_t binomial = 1; // C(n, i)
+    for (int i = 0; i < n; i++) {
+      w.next[n][i] = ((n - 1 - i) % 2 == 0) ? binomial : -binomial;
+      w.prev[n][n - 1 - i] = w.next[n][i];
+      w.absSum[n] += binomial;
+      binomial = (int128)binomial * (n - i) / (i + 1);
+    }
   }
-  return out;
+  return w;
 }
 
-// Return next element in sequence, assumes one of the derivatives is constant
-int64_t nextInSequence(const vector<int64_t> &sequence) { 
-  // Get derivatives until 0, sum last difference
-  auto dSeq = sequence;
-  auto lastDiff = int64_t{0};
-  while (!ranges::all_of(dSeq, [](auto n) { return n == 0; })) {
-    dSeq = diff(dSeq);
-    lastDiff += dSeq.back();
+constexpr auto weights = makeWeights();
+
+/**
+ * Dot product of a sequence with a row of weights. When the result is bounded to fit
+ * in 64 bits the plain loop is used, which the compiler can vectorize. Otherwise it's
+ * accumulated in 128 bits, checking for overflow
+ *
+ * @param seq Sequence
+ * @param w Weights for the sequence length
+ * @param absSum Sum of the absolute weights
+ * @return Dot product, or nullopt on overflow
+*/
+optional<int128> dot(span<const int64_t> seq, const array<int64_t, MaxLength> &w, int64_t absSum) {
+  int64_t maxAbs = 0, bound;
+  for (auto x : seq) maxAbs = max(maxAbs, (x < 0) ? -x : x);
+
+  if (!__builtin_mul_overflow(maxAbs, absSum, &bound)) {
+    int64_t ret = 0;
+    for (size_t i = 0; i < seq.size(); i++) ret += w[i] * seq[i];
+    return ret;
+  }
+
+  int128 ret = 0;
+  for (size_t i = 0; i < seq.size(); i++) {
+    if (__builtin_add_overflow(ret, (int128)w[i] * seq[i], &ret)) return nullopt;
   }
-  return sequence.back() + lastDiff;
+  return ret;
 }
 
-// Parse input to lines of vector of numbers
-auto parseInput(const string &input) {
-  return input 
-    | splitString('\n')
-    | views::transform([](auto s) { return toVector(s | splitNumbers<int64_t>(' ')); });
+/**
+ * Sum of the extrapolated values of all sequences on the input, forwards or backwards.
+ * Each line is parsed to a fixed buffer, so there are no allocations
+ *
+ * @param input Input
+ * @param forward Whether to extrapolate forwards (next) or backwards (previous)
+ * @return Sum of extrapolated values, or nothing if a sequence is too long or overflows
+*/
+Result solve(const string &input, bool forward) {
+  auto seq = array<int64_t, MaxLength>{};
+  int128 ret = 0;
+  for (auto line : input | splitString('\n')) {
+    int n = 0;
+    for (auto x : line | splitNumbers<int64_t>(' ')) {
+      if (n == MaxLength) return monostate();
+      seq[n++] = x;
+    }
+    auto value = dot(span(seq.data(), n), forward ? weights.next[n] : weights.prev[n], weights.absSum[n]);
+    if (!value || __builtin_add_overflow(ret, *value, &ret)) return monostate();
+  }
+  if (ret < INT64_MIN || ret > INT64_MAX) return monostate();
+  return (int64_t)ret;
 }
 
 Result solvePartOne(const string &input) {
-  auto rg = parseInput(input)
-    | views::transform(nextInSequence);
-  return accumulate(rg.begin(), rg.end(), 0);
+  return solve(input, true);
 }
 
 Result solvePartTwo(const string &input) {
-  // Same as part one with input number reversed
-  auto rg = parseInput(input)
-    | views::transform([](const vector<int64_t> &sequence) { 
-      return nextInSequence(vector(sequence.rbegin(), sequence.rend()));
-    });
-  return accumulate(rg.begin(), rg.end(), 0);
+  return solve(input, false);
 }
 } // namespace aoc9
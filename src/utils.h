@@ -5,10 +5,19 @@
 #include <string_view>
 #include <ranges>
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
 #include <cmath>
 #include <vector>
 #include <ostream>
 #include <functional>
+#include <numeric>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <cstdint>
+#include <climits>
 
 namespace aoc {
 
@@ -227,6 +236,269 @@ inline bool insideBoard(const std::vector<T> &board, vec2<U> pos) {
   return inBounds(pos.x, 0, w) && inBounds(pos.y, 0, h);
 }
 
+/**
+ * Grid of bits, stored line by line, with each line padded to a whole number of
+ * 64 bit words. Bit x of line y is bit x % 64 of word x / 64 of that line
+*/
+struct BitGrid {
+  int width = 0, height = 0, wordsPerLine = 0;
+  std::vector<uint64_t> words;
+
+  BitGrid() = default;
+  BitGrid(int w, int h) : width{w}, height{h}, wordsPerLine{(w + 63) / 64}, words((size_t)wordsPerLine * h) {}
+
+  uint64_t *line(int y) { return words.data() + (size_t)y * wordsPerLine; }
+  const uint64_t *line(int y) const { return words.data() + (size_t)y * wordsPerLine; }
+
+  bool test(int x, int y) const { return (line(y)[x / 64] >> (x % 64)) & 1; }
+  void set(int x, int y, bool value = true) {
+    auto bit = uint64_t{1} << (x % 64);
+    line(y)[x / 64] = value ? (line(y)[x / 64] | bit) : (line(y)[x / 64] & ~bit);
+  }
+
+  // Calls f(word index, mask) for each word covering bits [from, to) of a line
+  template<typename F>
+  static void forRange(int from, int to, F f) {
+    while (from < to) {
+      int n = std::min(64 - from % 64, to - from);
+      auto mask = ((n == 64) ? ~uint64_t{0} : ((uint64_t{1} << n) - 1)) << (from % 64);
+      f(from / 64, mask);
+      from += n;
+    }
+  }
+
+  // Number of bits set on line y in [from, to)
+  int count(int y, int from, int to) const {
+    int ret = 0;
+    forRange(from, to, [&](int w, uint64_t mask) { ret += std::popcount(line(y)[w] & mask); });
+    return ret;
+  }
+
+  // Sets or clears the bits of line y in [from, to)
+  void assign(int y, int from, int to, bool value) {
+    auto *l = line(y);
+    forRange(from, to, [&](int w, uint64_t mask) { l[w] = value ? (l[w] | mask) : (l[w] & ~mask); });
+  }
+
+  // Transposes a 64x64 block of bits in place (Hacker's Delight, recursive block swaps)
+  static void transpose64(std::array<uint64_t, 64> &a) {
+    uint64_t m = 0x00000000FFFFFFFF;
+    for (int j = 32; j != 0; j >>= 1, m ^= m << j) {
+      for (int k = 0; k < 64; k = ((k | j) + 1) & ~j) {
+        uint64_t t = ((a[k] >> j) ^ a[k | j]) & m;
+        a[k] ^= t << j;
+        a[k | j] ^= t;
+      }
+    }
+  }
+
+  // Transposes the grid into dest, 64x64 blocks at a time, reusing dest's storage
+  void transposeInto(BitGrid &dest) const {
+    dest.width = height;
+    dest.height = width;
+    dest.wordsPerLine = (height + 63) / 64;
+    dest.words.assign((size_t)dest.wordsPerLine * dest.height, 0);
+    auto block = std::array<uint64_t, 64>{};
+    for (int by = 0; by < dest.wordsPerLine; by++) {
+      for (int bx = 0; bx < wordsPerLine; bx++) {
+        for (int i = 0; i < 64; i++) block[i] = (by * 64 + i < height) ? line(by * 64 + i)[bx] : 0;
+        transpose64(block);
+        for (int i = 0; i < 64 && bx * 64 + i < width; i++) dest.line(bx * 64 + i)[by] = block[i];
+      }
+    }
+  }
+
+  bool operator==(const BitGrid &) const = default;
+};
+
+/**
+ * Combines two congruences t = a1 (mod m1) and t = a2 (mod m2) into one, with
+ * moduli not necessarily coprime (generalized Chinese Remainder Theorem)
+ *
+ * @param a1 Residue of the first congruence
+ * @param m1 Modulus of the first congruence
+ * @param a2 Residue of the second congruence
+ * @param m2 Modulus of the second congruence
+ * @return Pair (a, lcm(m1, m2)), with 0 <= a < lcm(m1, m2), or nullopt if there's no solution
+*/
+inline std::optional<std::pair<int64_t, int64_t>> crt(int64_t a1, int64_t m1, int64_t a2, int64_t m2) {
+  int64_t g = std::gcd(m1, m2), diff = a2 - a1;
+  if (diff % g != 0) return std::nullopt;
+
+  // Inverse of m1/g modulo m2/g, by the extended Euclidean algorithm
+  int64_t mod = m2 / g, r0 = (m1 / g) % mod, r1 = mod, s0 = 1, s1 = 0;
+  while (r1 != 0) {
+    int64_t q = r0 / r1;
+    r0 = std::exchange(r1, r0 - q * r1);
+    s0 = std::exchange(s1, s0 - q * s1);
+  }
+  __int128 k = (__int128)(diff / g) * s0 % mod, l = (__int128)m1 * mod;
+  __int128 a = ((a1 + m1 * k) % l + l) % l;
+  return std::make_pair((int64_t)a, (int64_t)l);
+}
+
+/**
+ * Times at which a periodic process has some event: once on each of the times in
+ * `before`, which happen before it starts cycling at time `offset`, and then
+ * periodically, on each time t >= offset such that t % period is one of the
+ * `residues` (both kept sorted)
+*/
+struct PeriodicEvents {
+  int64_t offset, period;
+  std::vector<int64_t> before, residues;
+
+  bool at(int64_t t) const {
+    if (t < offset) return std::ranges::binary_search(before, t);
+    return std::ranges::binary_search(residues, t % period);
+  }
+};
+
+/**
+ * First time at which all processes have an event simultaneously. If each one has
+ * its events exactly at the end of its cycles, this is the LCM of the periods.
+ * Otherwise, times before all processes are cycling are checked directly, and after
+ * that the residues of all processes are combined by the Chinese Remainder Theorem
+ *
+ * @param processes Events of each process
+ * @return First common time, if any
+*/
+inline std::optional<int64_t> firstCommonEvent(const std::vector<PeriodicEvents> &processes) {
+  if (std::ranges::all_of(processes, [](const auto &p) {
+      return p.before.empty() && p.residues == std::vector<int64_t>{0} && p.offset <= p.period;
+    })) {
+    int64_t ret = 1;
+    for (const auto &p : processes) ret = std::lcm(ret, p.period);
+    return ret;
+  }
+
+  // Before all processes are cycling, the candidates are the times of the one that takes longer to cycle
+  const auto &slowest = *std::ranges::max_element(processes, {}, &PeriodicEvents::offset);
+  for (auto t : slowest.before) {
+    if (std::ranges::all_of(processes, [t](const auto &p) { return p.at(t); })) return t;
+  }
+
+  // Congruences t = a (mod m) that satisfy all processes combined so far
+  auto congruences = std::vector<std::pair<int64_t, int64_t>>{{0, 1}}, next = decltype(congruences){};
+  for (const auto &p : processes) {
+    next.clear();
+    for (auto [a, m] : congruences) {
+      for (auto r : p.residues) {
+        if (auto c = crt(a, m, r, p.period)) next.push_back(*c);
+      }
+    }
+    std::swap(congruences, next);
+  }
+
+  std::optional<int64_t> ret;
+  for (auto [a, m] : congruences) {
+    auto t = (a >= slowest.offset) ? a : a + (slowest.offset - a + m - 1) / m * m;
+    ret = std::min(ret.value_or(t), t);
+  }
+  return ret;
+}
+
+/**
+ * Minimum cost search on a graph with non-negative integer edge costs (Dijkstra's
+ * algorithm, or A* when given a consistent heuristic) using a bucket queue. As the
+ * priorities popped are monotone and increase by at most maxStep along an edge, only
+ * maxStep + 1 circular buckets are needed. States are integer ids, so the best cost
+ * found for each one is kept in a flat array, and successors are generated into a
+ * buffer that's reused for all expansions
+ *
+ * @param stateCount Number of states, with ids in [0, stateCount)
+ * @param starts Start states
+ * @param maxStep Maximum increase of priority along an edge (edge cost plus heuristic increase)
+ * @param successors Function (state, buffer) that appends (next state, edge cost) pairs to buffer
+ * @param isGoal Predicate for goal states
+ * @param heuristic Consistent estimate of the cost from a state to a goal
+ * @return Minimum cost to reach a goal state, if reachable
+*/
+template<typename Successors, typename IsGoal, typename Heuristic>
+std::optional<int64_t> bucketSearch(size_t stateCount, const std::vector<int> &starts, int maxStep,
+    Successors successors, IsGoal isGoal, Heuristic heuristic) {
+  auto best = std::vector<int>(stateCount, INT_MAX);
+  auto buckets = std::vector<std::vector<std::pair<int, int>>>(maxStep + 1);
+  auto next = std::vector<std::pair<int, int>>{};
+  size_t pending = 0;
+  int64_t priority = INT64_MAX;
+  for (int s : starts) {
+    best[s] = 0;
+    buckets[heuristic(s) % buckets.size()].push_back({s, 0});
+    priority = std::min<int64_t>(priority, heuristic(s));
+    pending++;
+  }
+
+  for (; pending > 0; priority++) {
+    auto &bucket = buckets[priority % buckets.size()];
+    for (size_t i = 0; i < bucket.size(); i++) {
+      auto [state, cost] = bucket[i];
+      pending--;
+      if (cost > best[state]) continue;
+      if (isGoal(state)) return cost;
+
+      next.clear();
+      successors(state, next);
+      for (auto [nextState, edgeCost] : next) {
+        int nextCost = cost + edgeCost;
+        if (nextCost >= best[nextState]) continue;
+        best[nextState] = nextCost;
+        buckets[(nextCost + heuristic(nextState)) % buckets.size()].push_back({nextState, nextCost});
+        pending++;
+      }
+    }
+    bucket.clear();
+  }
+  return std::nullopt;
+}
+
+template<typename Successors, typename IsGoal>
+std::optional<int64_t> bucketSearch(size_t stateCount, const std::vector<int> &starts, int maxStep,
+    Successors successors, IsGoal isGoal) {
+  return bucketSearch(stateCount, starts, maxStep, successors, isGoal, [](int) { return 0; });
+}
+
+/**
+ * Parallel reduction of n items. Threads take the next item from a shared counter as
+ * they finish the previous one, each with its own state (for buffers that are reused
+ * between items) and its own local value, so they only write once they're done. The
+ * thread values are then combined, which must be associative and commutative, with
+ * init as its identity
+ *
+ * @param n Number of items
+ * @param init Identity value of combine
+ * @param makeState Function () that creates the state of a thread
+ * @param f Function (state, i) that returns the value of item i
+ * @param combine Function (a, b) that combines two values
+ * @return Combination of the values of all items, or init if there are none
+*/
+template<typename T, typename MakeState, typename F, typename Combine>
+T parallelReduce(size_t n, T init, MakeState makeState, F f, Combine combine) {
+  int threadCount = std::max<int>(1, std::min<size_t>(std::thread::hardware_concurrency(), n));
+  auto partials = std::vector<T>(threadCount, init);
+  auto next = std::atomic<size_t>{0};
+  {
+    auto threads = std::vector<std::jthread>{};
+    for (int t = 0; t < threadCount; t++) {
+      threads.emplace_back([&, t]() {
+        auto state = makeState();
+        T local = init;
+        for (size_t i = next++; i < n; i = next++) local = combine(std::move(local), f(state, i));
+        partials[t] = std::move(local);
+      });
+    }
+  }
+  T ret = std::move(init);
+  for (auto &partial : partials) ret = combine(std::move(ret), std::move(partial));
+  return ret;
+}
+
+template<typename T, typename F, typename Combine>
+T parallelReduce(size_t n, T init, F f, Combine combine) {
+  struct NoState {};
+  return parallelReduce(n, std::move(init), []() { return NoState{}; },
+    [&f](NoState &, size_t i) { return f(i); }, combine);
+}
+
 } // namespace aoc
 
 /**